@@ -0,0 +1,330 @@
+#include "conditions.h"
+
+#include "re.h"
+
+namespace kaputt
+{
+ConditionEvaluator::ConditionEvaluator(RE::Actor* attacker, RE::Actor* victim, bool validate) :
+    attacker(attacker), victim(victim), validate(validate), params(attacker->As<RE::TESObjectREFR>(), victim->As<RE::TESObjectREFR>()) {}
+
+bool ConditionEvaluator::isTrue(RE::TESConditionItem* item)
+{
+    auto value = evalNative(item->data);
+    if (!value)
+    {
+        fallback_count.fetch_add(1, std::memory_order_relaxed);
+        return item->IsTrue(params);
+    }
+    native_count.fetch_add(1, std::memory_order_relaxed);
+
+    bool result = compareCondition(*value, item->data);
+    if (validate)
+        if (bool expected = item->IsTrue(params); expected != result)
+        {
+            mismatch_count.fetch_add(1, std::memory_order_relaxed);
+            logger::warn("Native condition function {} gave {} (value {}), the game gave {}.",
+                         static_cast<uint32_t>(item->data.functionData.function.get()), result, *value, expected);
+            return expected;
+        }
+    return result;
+}
+
+bool ConditionEvaluator::isTrue(const RE::TESCondition& condition)
+{
+    bool result   = true;
+    bool or_cache = false;
+    for (auto item = condition.head; item != nullptr; item = item->next)
+    {
+        or_cache |= isTrue(item);
+        if (!item->next || !item->data.flags.isOR)
+        {
+            result &= or_cache;
+            or_cache = false;
+        }
+    }
+    return result;
+}
+
+std::optional<float> ConditionEvaluator::evalNative(const RE::CONDITION_ITEM_DATA& data)
+{
+    using FunctionID = RE::FUNCTION_DATA::FunctionID;
+
+    if (data.flags.swapTarget)
+        return std::nullopt;
+
+    RE::Actor* subject = nullptr;
+    switch (data.object.get())
+    {
+        case RE::CONDITIONITEMOBJECT::kSelf:
+            subject = attacker;
+            break;
+        case RE::CONDITIONITEMOBJECT::kTarget:
+            subject = victim;
+            break;
+        default:
+            return std::nullopt;
+    }
+
+    auto param = data.functionData.params[0];
+    switch (data.functionData.function.get())
+    {
+        case FunctionID::kGetEquippedItemType:
+            if (auto& types = getEquippedTypes(subject); types.isKnown())
+                return static_cast<float>((reinterpret_cast<uintptr_t>(param) != 0) ? types.right : types.left);
+            return std::nullopt;
+        case FunctionID::kGetIsRace:
+            return (subject->GetRace() == static_cast<RE::TESRace*>(param)) ? 1.f : 0.f;
+        case FunctionID::kGetHeadingAngle:
+            if (auto ref = static_cast<RE::TESObjectREFR*>(param); ref)
+                return subject->GetHeadingAngle(ref->GetPosition(), false);
+            return std::nullopt;
+        case FunctionID::kIsSneaking:
+            return subject->IsSneaking() ? 1.f : 0.f;
+        case FunctionID::kIsBleedingOut:
+            return subject->AsActorState()->IsBleedingOut() ? 1.f : 0.f;
+        default:
+            return std::nullopt;
+    }
+}
+
+const EquippedTypes& ConditionEvaluator::getEquippedTypes(const RE::Actor* actor)
+{
+    auto& types = equipped_types[actor == victim];
+    if (!types)
+        types = WeaponCache::getSingleton()->get(actor);
+    return *types;
+}
+
+std::optional<bool> ConditionEvaluator::matchWeapons(const TaggerItemInfo& info, const RE::TESCondition& condition)
+{
+    auto subject = (info.deps == ConditionDeps::kAttacker) ? attacker : victim;
+    auto types   = getEquippedTypes(subject);
+    if (!info.reads_left)
+        types.left = 0; // any type gives the same outcome
+    if (!types.isKnown())
+        return std::nullopt;
+
+    bool result = info.weapon_accepts.test(types.combo());
+    if (validate)
+        if (bool expected = isTrueByGame(condition); expected != result)
+        {
+            mismatch_count.fetch_add(1, std::memory_order_relaxed);
+            auto const& cached = getEquippedTypes(subject);
+            logger::warn("Cached equipped types of {} (left {}, right {}) gave {}, the game gave {}.",
+                         subject->GetName(), cached.left, cached.right, result, expected);
+            return expected;
+        }
+    return result;
+}
+
+bool ConditionEvaluator::isTrueByGame(const RE::TESCondition& condition)
+{
+    bool result   = true;
+    bool or_cache = false;
+    for (auto item = condition.head; item != nullptr; item = item->next)
+    {
+        or_cache |= item->IsTrue(params);
+        if (!item->next || !item->data.flags.isOR)
+        {
+            result &= or_cache;
+            or_cache = false;
+        }
+    }
+    return result;
+}
+
+EquippedTypes WeaponCache::get(const RE::Actor* actor)
+{
+    std::lock_guard guard(lock);
+
+    if (auto types = entries.find(actor->GetFormID()); types)
+        return *types;
+    return entries.getOrInsert(actor->GetFormID()) = {getType(actor, true), getType(actor, false)};
+}
+
+void WeaponCache::forget(RE::FormID actor)
+{
+    std::lock_guard guard(lock);
+    entries.erase(actor);
+}
+
+void WeaponCache::clear()
+{
+    std::lock_guard guard(lock);
+    entries.clear();
+}
+
+// GetEquippedItemType, unknown if the hand is empty but might hold a shield
+int8_t WeaponCache::getType(const RE::Actor* actor, bool left_hand)
+{
+    auto form = actor->GetEquippedObject(left_hand);
+    if (!form)
+        return static_cast<int8_t>(left_hand ? EquippedTypes::unknown : 0); // hand to hand
+    if (auto weapon = form->As<RE::TESObjectWEAP>(); weapon)
+        return static_cast<int8_t>(weapon->IsCrossbow() ? 12 : static_cast<int>(weapon->GetWeaponType()));
+    if (form->Is(RE::FormType::Spell))
+        return 9;
+    if (form->Is(RE::FormType::Armor))
+        return 10;
+    if (form->Is(RE::FormType::Light))
+        return 11;
+    return EquippedTypes::unknown;
+}
+
+namespace
+{
+enum class FunctionKind : uint8_t
+{
+    kUnknown,
+    kActorStable, // identity and equipment of the subject
+    kActorState,  // state of the subject that changes on its own
+    kPair         // relation between subject and target
+};
+
+FunctionKind getFunctionKind(RE::FUNCTION_DATA::FunctionID function)
+{
+    using FunctionID = RE::FUNCTION_DATA::FunctionID;
+    switch (function)
+    {
+        case FunctionID::kGetEquippedItemType:
+        case FunctionID::kGetIsRace:
+        case FunctionID::kGetIsSex:
+        case FunctionID::kGetIsID:
+        case FunctionID::kHasKeyword:
+        case FunctionID::kWornHasKeyword:
+            return FunctionKind::kActorStable;
+        case FunctionID::kGetLevel: // level ups, perks and factions change without an event we listen to
+        case FunctionID::kHasPerk:
+        case FunctionID::kGetInFaction:
+        case FunctionID::kIsSneaking:
+        case FunctionID::kIsBleedingOut:
+        case FunctionID::kIsRunning:
+        case FunctionID::kIsSwimming:
+        case FunctionID::kIsWeaponOut:
+        case FunctionID::kIsInCombat:
+        case FunctionID::kGetActorValue:
+        case FunctionID::kGetActorValuePercent:
+            return FunctionKind::kActorState;
+        case FunctionID::kGetHeadingAngle:
+        case FunctionID::kGetDistance:
+        case FunctionID::kGetRelativeAngle:
+        case FunctionID::kGetLineOfSight:
+        case FunctionID::kGetDetected:
+            return FunctionKind::kPair;
+        default:
+            return FunctionKind::kUnknown; // incl. GetRandomPercent and graph variables
+    }
+}
+} // namespace
+
+TaggerItemInfo analyzeConditions(const RE::TESCondition& condition)
+{
+    TaggerItemInfo info = {.deps = ConditionDeps::kNone, .weapon_only = true};
+
+    auto merge = [&](ConditionDeps deps) {
+        if (info.deps == ConditionDeps::kNone || info.deps == deps)
+            info.deps = deps;
+        else if (info.deps != ConditionDeps::kVolatile && deps != ConditionDeps::kVolatile)
+            info.deps = ConditionDeps::kPair; // attacker and victim
+        else
+            info.deps = ConditionDeps::kVolatile;
+    };
+
+    for (auto item = condition.head; item != nullptr; item = item->next)
+    {
+        auto& data = item->data;
+        auto  kind = getFunctionKind(data.functionData.function.get());
+        if (kind == FunctionKind::kUnknown || data.flags.swapTarget || data.flags.global) // a global may change any time
+        {
+            merge(ConditionDeps::kVolatile);
+            continue;
+        }
+
+        info.weapon_only &= (data.functionData.function.get() == RE::FUNCTION_DATA::FunctionID::kGetEquippedItemType);
+        info.frame_only |= (kind != FunctionKind::kActorStable);
+        if (kind == FunctionKind::kPair)
+            merge(ConditionDeps::kPair);
+        else if (data.object.get() == RE::CONDITIONITEMOBJECT::kSelf)
+            merge(ConditionDeps::kAttacker);
+        else if (data.object.get() == RE::CONDITIONITEMOBJECT::kTarget)
+            merge(ConditionDeps::kVictim);
+        else
+            merge(ConditionDeps::kVolatile);
+    }
+
+    info.weapon_only &= (info.deps == ConditionDeps::kAttacker) || (info.deps == ConditionDeps::kVictim);
+    if (info.weapon_only) // the outcome for every combination of types, same grouping as ConditionEvaluator
+        for (int8_t left = 0; left < static_cast<int8_t>(EquippedTypes::type_count); ++left)
+            for (int8_t right = 0; right < static_cast<int8_t>(EquippedTypes::type_count); ++right)
+            {
+                bool result   = true;
+                bool or_cache = false;
+                for (auto item = condition.head; item != nullptr; item = item->next)
+                {
+                    bool is_right = reinterpret_cast<uintptr_t>(item->data.functionData.params[0]) != 0;
+                    info.reads_left |= !is_right;
+                    or_cache |= compareCondition(static_cast<float>(is_right ? right : left), item->data);
+                    if (!item->next || !item->data.flags.isOR)
+                    {
+                        result &= or_cache;
+                        or_cache = false;
+                    }
+                }
+                info.weapon_accepts.set(EquippedTypes{left, right}.combo(), result);
+            }
+    return info;
+}
+
+void TaggerCache::analyze(const RE::BSTArray<RE::TESForm*>& items)
+{
+    std::lock_guard guard(lock);
+
+    infos.clear();
+    entries.clear();
+    std::array<size_t, 5> counts = {};
+    for (uint32_t item_idx = 0; item_idx < items.size() && item_idx < max_items; ++item_idx)
+    {
+        auto idle = items[item_idx]->As<RE::TESIdleForm>();
+        auto info = idle ? analyzeConditions(idle->conditions) : TaggerItemInfo{};
+        infos.push_back(info);
+        ++counts[static_cast<size_t>(info.deps)];
+    }
+    logger::info("Tagger items: {} attacker only, {} victim only, {} pair, {} volatile, {} unconditional",
+                 counts[1], counts[2], counts[3], counts[4], counts[0]);
+}
+
+TaggerCache::Results TaggerCache::load(const RE::Actor* actor)
+{
+    std::lock_guard guard(lock);
+
+    auto entry = entries.find(actor->GetFormID());
+    if (!entry || entry->actor != actor)
+        return {};
+
+    auto results = entry->results;
+    if (entry->frame != UpdateHook::frame.load(std::memory_order_relaxed))
+    {
+        results.known &= ~results.frame_only;
+        results.frame_only.reset();
+    }
+    return results;
+}
+
+void TaggerCache::store(const RE::Actor* actor, const Results& results)
+{
+    std::lock_guard guard(lock);
+    entries.getOrInsert(actor->GetFormID()) = {actor, UpdateHook::frame.load(std::memory_order_relaxed), results};
+}
+
+void TaggerCache::forget(RE::FormID actor)
+{
+    std::lock_guard guard(lock);
+    entries.erase(actor);
+}
+
+void TaggerCache::clear()
+{
+    std::lock_guard guard(lock);
+    entries.clear();
+}
+} // namespace kaputt
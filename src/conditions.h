@@ -0,0 +1,152 @@
+#pragma once
+
+#include "containers.h"
+
+namespace kaputt
+{
+// GetEquippedItemType of both hands
+struct EquippedTypes
+{
+    static constexpr size_t type_count = 13; // hand to hand ... crossbow
+    static constexpr int8_t unknown    = -1; // left to the game, e.g. an empty left hand may hold a shield
+
+    int8_t left  = unknown;
+    int8_t right = unknown;
+
+    bool   isKnown() const { return left >= 0 && right >= 0; }
+    size_t combo() const { return left * type_count + right; } // known types only
+};
+
+// Equipped item types per actor. Filled on first use and dropped on equip events and when the
+// actor unloads, so it holds no more than the loaded actors.
+class WeaponCache
+{
+public:
+    static WeaponCache* getSingleton()
+    {
+        static WeaponCache cache;
+        return std::addressof(cache);
+    }
+
+    EquippedTypes get(const RE::Actor* actor);
+    void          forget(RE::FormID actor);
+    void          clear();
+
+private:
+    std::mutex                     lock    = {};
+    FormTable<EquippedTypes, 1024> entries = {};
+
+    static int8_t getType(const RE::Actor* actor, bool left_hand);
+};
+
+// What a tagger item's conditions read, decides whether its result can be reused.
+enum class ConditionDeps : uint8_t
+{
+    kNone,     // no conditions
+    kAttacker, // only the attacker
+    kVictim,   // only the victim
+    kPair,     // both, or how they relate
+    kVolatile  // random, other items' results or unknown functions
+};
+
+struct TaggerItemInfo
+{
+    ConditionDeps deps        = ConditionDeps::kVolatile;
+    bool          frame_only  = false; // reads state that changes without an equip event, e.g. sneaking
+    bool          weapon_only = false; // only GetEquippedItemType of one actor, decided by weapon_accepts
+    bool          reads_left  = false; // of weapon_only items
+
+    std::bitset<EquippedTypes::type_count * EquippedTypes::type_count> weapon_accepts = {}; // by EquippedTypes::combo
+};
+
+TaggerItemInfo analyzeConditions(const RE::TESCondition& condition);
+
+// Evaluates IdleTagger conditions for one submit. The functions tagger items use the most
+// are implemented natively and read the actors once, the rest go through the game's dispatch.
+// In validation mode native results are checked against the game's and mismatches are logged.
+class ConditionEvaluator
+{
+public:
+    ConditionEvaluator(RE::Actor* attacker, RE::Actor* victim, bool validate);
+
+    bool isTrue(RE::TESConditionItem* item);        // a single item, OR flags are up to the caller
+    bool isTrue(const RE::TESCondition& condition); // the whole list, same grouping as the game
+
+    // weapon only items from the cached equipped types, nullopt if a type is unknown. Validated like the native functions.
+    std::optional<bool> matchWeapons(const TaggerItemInfo& info, const RE::TESCondition& condition);
+
+    static uint64_t getNativeCount() { return native_count.load(std::memory_order_relaxed); }
+    static uint64_t getFallbackCount() { return fallback_count.load(std::memory_order_relaxed); }
+    static uint64_t getMismatchCount() { return mismatch_count.load(std::memory_order_relaxed); }
+
+private:
+    RE::Actor*               attacker;
+    RE::Actor*               victim;
+    bool                     validate;
+    RE::ConditionCheckParams params;
+
+    std::array<std::optional<EquippedTypes>, 2> equipped_types = {}; // attacker, victim
+
+    static inline std::atomic_uint64_t native_count   = 0;
+    static inline std::atomic_uint64_t fallback_count = 0;
+    static inline std::atomic_uint64_t mismatch_count = 0;
+
+    std::optional<float> evalNative(const RE::CONDITION_ITEM_DATA& data); // function value, nullopt if not handled
+    bool                 isTrueByGame(const RE::TESCondition& condition);
+    const EquippedTypes& getEquippedTypes(const RE::Actor* actor);
+};
+
+// Results of the single-actor tagger items per actor, so they are evaluated once for all the
+// pairs an actor is in. Items on equipment and identity are kept until the actor equips something,
+// items on state until the next frame.
+class TaggerCache
+{
+public:
+    static constexpr size_t max_items = 128; // items past this are never cached
+
+    struct Results
+    {
+        std::bitset<max_items> known      = {};
+        std::bitset<max_items> value      = {};
+        std::bitset<max_items> frame_only = {};
+
+        std::optional<bool> get(size_t item_idx) const { return known.test(item_idx) ? std::optional{value.test(item_idx)} : std::nullopt; }
+        void                set(size_t item_idx, bool result, bool is_frame_only)
+        {
+            known.set(item_idx);
+            value.set(item_idx, result);
+            frame_only.set(item_idx, is_frame_only);
+        }
+    };
+
+    static TaggerCache* getSingleton()
+    {
+        static TaggerCache cache;
+        return std::addressof(cache);
+    }
+
+    void           analyze(const RE::BSTArray<RE::TESForm*>& items); // once the tagger root is loaded
+    TaggerItemInfo getInfo(size_t item_idx) const { return (item_idx < infos.size()) ? infos[item_idx] : TaggerItemInfo{}; }
+
+    Results load(const RE::Actor* actor); // empty if nothing is cached
+    void    store(const RE::Actor* actor, const Results& results);
+    void    forget(RE::FormID actor); // after the actor equipped something
+    void    clear();
+
+    uint64_t getHitCount() const { return hits.load(std::memory_order_relaxed); }
+    void     countHit() { hits.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    struct Entry
+    {
+        const RE::Actor* actor   = nullptr; // FormIDs of temporary refs get reused
+        uint64_t         frame   = 0;
+        Results          results = {};
+    };
+
+    std::mutex                  lock    = {};
+    FormTable<Entry, 256>       entries = {};
+    std::vector<TaggerItemInfo> infos   = {}; // by item index, written once at data load
+    std::atomic_uint64_t        hits    = 0;  // item evaluations saved
+};
+} // namespace kaputt
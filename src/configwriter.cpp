@@ -0,0 +1,91 @@
+#include "configwriter.h"
+
+#include "menu.h"
+#include "hotreload.h"
+
+namespace fs = std::filesystem;
+
+namespace kaputt
+{
+void ConfigWriter::queue(fs::path file_path, json snapshot)
+{
+    {
+        std::scoped_lock l(queue_mutex);
+        pending.insert_or_assign(std::move(file_path), std::move(snapshot));
+        if (!worker.joinable())
+            worker = std::jthread([this](std::stop_token stop_token) { run(stop_token); });
+    }
+    queue_cv.notify_one();
+}
+
+void ConfigWriter::run(std::stop_token stop_token)
+{
+    while (true)
+    {
+        std::map<fs::path, json> jobs;
+        {
+            std::unique_lock l(queue_mutex);
+            if (!queue_cv.wait(l, stop_token, [this] { return !pending.empty(); }))
+                return;
+            jobs.swap(pending);
+        }
+
+        for (auto const& [file_path, snapshot] : jobs)
+            write(file_path, snapshot);
+    }
+}
+
+bool ConfigWriter::write(const fs::path& file_path, const json& snapshot)
+{
+    auto content = snapshot.dump(4);
+    auto hash    = std::hash<std::string>{}(content);
+
+    std::error_code ec;
+    if (auto it = saved.find(file_path); it != saved.end())
+        if (auto mtime = fs::last_write_time(file_path, ec); !ec && (it->second.hash == hash) && (it->second.mtime == mtime))
+        {
+            logger::info("{} unchanged, skipped saving.", file_path.string());
+            setStatusMessage(std::format("No changes to save in {}", file_path.filename().string()));
+            return true;
+        }
+
+    auto tmp_path = fs::path{file_path}.concat(".tmp");
+    auto handle   = CreateFileW(tmp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        logger::warn("Failed to open {}", tmp_path.filename().string());
+        logger::warn("Kaputt config not saved!");
+        setStatusMessage("Something went wrong while saving. Please check the log.");
+        return false;
+    }
+
+    DWORD written = 0;
+    bool  ok      = WriteFile(handle, content.data(), static_cast<DWORD>(content.size()), &written, nullptr) &&
+        (written == content.size()) &&
+        FlushFileBuffers(handle);
+    CloseHandle(handle);
+
+    if (ok)
+    {
+        auto self_write = HotReload::getSingleton()->lockSelfWrite();
+        ok              = MoveFileExW(tmp_path.c_str(), file_path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+        if (ok && fs::equivalent(file_path, def_config_path, ec))
+            HotReload::getSingleton()->recordSelfWrite(self_write);
+    }
+
+    if (!ok)
+    {
+        logger::warn("Failed to write {}, error code {}", file_path.string(), GetLastError());
+        logger::warn("Kaputt config not saved!");
+        fs::remove(tmp_path, ec);
+        setStatusMessage("Something went wrong while saving. Please check the log.");
+        return false;
+    }
+
+    saved.insert_or_assign(file_path, SavedState{hash, fs::last_write_time(file_path, ec)});
+
+    logger::info("Kaputt config saved to {}.", file_path.string());
+    setStatusMessage(std::format("Config saved to {}", file_path.string()));
+    return true;
+}
+} // namespace kaputt
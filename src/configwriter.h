@@ -0,0 +1,39 @@
+#pragma once
+
+#include "utils.h"
+
+#include <condition_variable>
+#include <filesystem>
+
+namespace kaputt
+{
+// Writes config snapshots on a background thread. Each file is written to a temp file,
+// flushed to disk and renamed over the target, so a crash never leaves a truncated config.
+class ConfigWriter
+{
+public:
+    static ConfigWriter* getSingleton()
+    {
+        static ConfigWriter writer;
+        return std::addressof(writer);
+    }
+
+    void queue(std::filesystem::path file_path, json snapshot);
+
+private:
+    struct SavedState
+    {
+        size_t                          hash  = 0;
+        std::filesystem::file_time_type mtime = {};
+    };
+
+    std::mutex                                  queue_mutex;
+    std::condition_variable_any                 queue_cv;
+    std::map<std::filesystem::path, json>       pending = {}; // only the latest snapshot per file matters
+    std::map<std::filesystem::path, SavedState> saved   = {}; // worker thread only
+    std::jthread                                worker;
+
+    void run(std::stop_token stop_token);
+    bool write(const std::filesystem::path& file_path, const json& snapshot);
+};
+} // namespace kaputt
@@ -0,0 +1,127 @@
+#pragma once
+
+namespace kaputt
+{
+// Fixed-size ring buffer, the oldest item is overwritten when full.
+template <typename T, size_t N>
+class RingBuffer
+{
+public:
+    void push(const T& item)
+    {
+        items[head] = item;
+        head        = (head + 1) % N;
+        count       = std::min(count + 1, N);
+    }
+    void clear() { head = count = 0; }
+
+    size_t   size() const { return count; }
+    const T& recent(size_t i) const { return items[(head + N - 1 - i) % N]; } // 0 is the newest
+
+private:
+    std::array<T, N> items = {};
+    size_t           head  = 0;
+    size_t           count = 0;
+};
+
+// Open-addressing hash table keyed by FormID (or a pair of them packed in 64 bits) with a fixed
+// number of slots. Never allocates, the least recently touched entry is evicted once it is 3/4 full.
+template <typename V, size_t N, typename Key = RE::FormID>
+class FormTable
+{
+    static_assert(std::has_single_bit(N), "slot count must be a power of 2");
+    static_assert(std::is_unsigned_v<Key>);
+
+public:
+    V* find(Key key)
+    {
+        auto slot = findSlot(key);
+        if (!slot)
+            return nullptr;
+        slot->stamp = ++clock;
+        return &slot->value;
+    }
+    const V* find(Key key) const
+    {
+        auto slot = const_cast<FormTable*>(this)->findSlot(key);
+        return slot ? &slot->value : nullptr;
+    }
+
+    V& getOrInsert(Key key) // key must not be 0
+    {
+        if (auto value = find(key); value)
+            return *value;
+
+        if (count >= N / 4 * 3)
+            erase(std::ranges::min_element(slots, {}, [](const Slot& slot) { return slot.key ? slot.stamp : std::numeric_limits<uint64_t>::max(); })->key);
+
+        auto i = home(key);
+        while (slots[i].key)
+            i = (i + 1) & (N - 1);
+        slots[i] = {key, ++clock, {}};
+        ++count;
+        return slots[i].value;
+    }
+
+    bool erase(Key key)
+    {
+        auto slot = findSlot(key);
+        if (!slot)
+            return false;
+
+        // backward shift deletion, keeps probe chains intact without tombstones
+        size_t i = slot - slots.data();
+        for (size_t j = (i + 1) & (N - 1); slots[j].key; j = (j + 1) & (N - 1))
+        {
+            auto k = home(slots[j].key);
+            if ((j > i) ? (k <= i || k > j) : (k <= i && k > j))
+            {
+                slots[i] = std::move(slots[j]);
+                i        = j;
+            }
+        }
+        slots[i] = {};
+        --count;
+        return true;
+    }
+
+    void clear()
+    {
+        slots.fill({});
+        count = 0;
+    }
+    size_t size() const { return count; }
+
+    template <typename F>
+    void forEach(F&& func) const
+    {
+        for (auto const& slot : slots)
+            if (slot.key)
+                func(slot.key, slot.value);
+    }
+
+private:
+    struct Slot
+    {
+        Key      key   = 0; // 0 marks an empty slot
+        uint64_t stamp = 0;
+        V        value = {};
+    };
+
+    std::array<Slot, N> slots = {};
+    size_t              count = 0;
+    uint64_t            clock = 0;
+
+    static size_t home(Key key) { return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> (64 - std::countr_zero(N))); }
+
+    Slot* findSlot(Key key)
+    {
+        if (!key)
+            return nullptr;
+        for (auto i = home(key); slots[i].key; i = (i + 1) & (N - 1))
+            if (slots[i].key == key)
+                return &slots[i];
+        return nullptr;
+    }
+};
+} // namespace kaputt
@@ -0,0 +1,62 @@
+#include "failcache.h"
+
+namespace kaputt
+{
+FailureCache::Lookup FailureCache::lookup(const RE::Actor* attacker, const RE::Actor* victim)
+{
+    std::lock_guard guard(lock);
+
+    auto key   = makeKey(attacker, victim);
+    auto entry = entries.find(key);
+    if (!entry)
+        return Lookup::kMiss;
+    if (Clock::now() >= entry->expiry)
+    {
+        entries.erase(key);
+        return Lookup::kMiss;
+    }
+
+    return (++hits % verify_every == 0) ? Lookup::kVerify : Lookup::kSkip;
+}
+
+void FailureCache::countVerify(FailReason precondition)
+{
+    if (precondition == FailReason::kNone)
+        false_negatives.fetch_add(1, std::memory_order_relaxed);
+    else
+        verified.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FailureCache::record(const RE::Actor* attacker, const RE::Actor* victim, FailReason reason, float ttl)
+{
+    std::lock_guard guard(lock);
+
+    auto key = makeKey(attacker, victim);
+    if (!isCacheable(reason) || !(ttl > 0.f))
+    {
+        entries.erase(key);
+        return;
+    }
+
+    entries.getOrInsert(key) = {Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(ttl)), reason};
+}
+
+void FailureCache::clear()
+{
+    std::lock_guard guard(lock);
+    entries.clear();
+}
+
+void FailureCache::forget(RE::FormID actor)
+{
+    std::lock_guard guard(lock);
+
+    std::vector<uint64_t> keys;
+    entries.forEach([&](uint64_t key, const Entry&) {
+        if (static_cast<RE::FormID>(key >> 32) == actor || static_cast<RE::FormID>(key) == actor)
+            keys.push_back(key);
+    });
+    for (auto key : keys)
+        entries.erase(key);
+}
+} // namespace kaputt
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "kaputt.h"
+#include "containers.h"
+
+namespace kaputt
+{
+// Recent precondition failures per attacker/victim pair, so the same doomed pair is skipped
+// for a short while instead of going through the checks on every swing.
+// Every few hits a cached pair is checked anyway to count how often the cache was wrong.
+class FailureCache
+{
+public:
+    enum class Lookup : uint8_t
+    {
+        kMiss,   // not known to fail, run the checks
+        kSkip,   // failed recently, skip the checks
+        kVerify, // failed recently, run the checks anyway and pass the precondition to countVerify
+    };
+
+    static FailureCache* getSingleton()
+    {
+        static FailureCache cache;
+        return std::addressof(cache);
+    }
+
+    Lookup lookup(const RE::Actor* attacker, const RE::Actor* victim);
+    void   record(const RE::Actor* attacker, const RE::Actor* victim, FailReason reason, float ttl); // ttl in seconds, 0 disables
+
+    void countSkip() { avoided.fetch_add(1, std::memory_order_relaxed); } // a kSkip whose precondition really wasn't checked
+    void countVerify(FailReason precondition);                            // right after a kVerify's precondition, whatever the submit does
+
+    void clear();                  // after config or registry changes
+    void forget(RE::FormID actor); // after the actor's equipment changed
+
+    // Failures that hold for a while and are the same for every trigger. Only the precondition's are, a failed
+    // submit depends on the trigger's submit info, e.g. the sneak trigger requiring "sneak".
+    static constexpr bool isCacheable(FailReason reason)
+    {
+        switch (reason)
+        {
+            case FailReason::kEssential:
+            case FailReason::kProtected:
+            case FailReason::kFurniture:
+            case FailReason::kHeight:
+            case FailReason::kHostileInRange:
+            case FailReason::kRace:
+                return true;
+            default: // kNotPlayable is mostly transient, e.g. mid-attack or ragdolled
+                return false;
+        }
+    }
+
+    uint64_t getAvoidedCount() const { return avoided.load(std::memory_order_relaxed); }
+    uint64_t getVerifiedCount() const { return verified.load(std::memory_order_relaxed); }
+    uint64_t getFalseNegativeCount() const { return false_negatives.load(std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        Clock::time_point expiry = {};
+        FailReason        reason = FailReason::kNone;
+    };
+
+    static constexpr uint64_t verify_every = 16; // hits
+
+    std::mutex                      lock    = {};
+    FormTable<Entry, 256, uint64_t> entries = {}; // (attacker << 32 | victim) -> entry
+    uint64_t                        hits    = 0;
+
+    std::atomic_uint64_t avoided         = 0; // checks skipped
+    std::atomic_uint64_t verified        = 0; // cached pairs checked again and still failing
+    std::atomic_uint64_t false_negatives = 0; // cached pairs checked again that went through
+
+    static uint64_t makeKey(const RE::Actor* attacker, const RE::Actor* victim)
+    {
+        return (static_cast<uint64_t>(attacker->GetFormID()) << 32) | victim->GetFormID();
+    }
+};
+static_assert(!FailureCache::isCacheable(FailReason::kNoAnimation) && !FailureCache::isCacheable(FailReason::kNoTaggedAnimation),
+              "one trigger's failed submit must not hold back another trigger");
+} // namespace kaputt
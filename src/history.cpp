@@ -0,0 +1,100 @@
+#include "history.h"
+
+namespace kaputt
+{
+void PlayHistory::record(const RE::Actor* attacker, RE::FormID idle)
+{
+    global.push(idle);
+    if (attacker)
+        by_attacker.getOrInsert(attacker->GetFormID()).push(idle);
+}
+
+void PlayHistory::clear()
+{
+    global.clear();
+    by_attacker.clear();
+}
+
+size_t PlayHistory::getRecent(const RE::Actor* attacker, size_t depth, size_t attacker_depth, std::span<RE::FormID> out) const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < std::min(depth, global.size()) && count < out.size(); ++i)
+        out[count++] = global.recent(i);
+
+    if (auto buffer = attacker ? by_attacker.find(attacker->GetFormID()) : nullptr; buffer)
+        for (size_t i = 0; i < std::min(attacker_depth, buffer->size()) && count < out.size(); ++i)
+            out[count++] = buffer->recent(i);
+
+    return count;
+}
+
+bool PlayHistory::writeBuffer(SKSE::SerializationInterface* intfc, const Buffer& buffer)
+{
+    if (!intfc->WriteRecordData(static_cast<uint32_t>(buffer.size())))
+        return false;
+    for (size_t i = buffer.size(); i-- > 0;) // oldest first
+        if (!intfc->WriteRecordData(buffer.recent(i)))
+            return false;
+    return true;
+}
+
+bool PlayHistory::readBuffer(SKSE::SerializationInterface* intfc, Buffer& buffer)
+{
+    uint32_t size = 0;
+    if (!intfc->ReadRecordData(size))
+        return false;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        RE::FormID idle = 0;
+        if (!intfc->ReadRecordData(idle))
+            return false;
+        if (intfc->ResolveFormID(idle, idle)) // dropped if its plugin is gone
+            buffer.push(idle);
+    }
+    return true;
+}
+
+void PlayHistory::save(SKSE::SerializationInterface* intfc) const
+{
+    if (!intfc->OpenRecord(record_type, record_version))
+    {
+        logger::warn("Failed to open play history record!");
+        return;
+    }
+
+    bool ok = writeBuffer(intfc, global) && intfc->WriteRecordData(static_cast<uint32_t>(by_attacker.size()));
+    by_attacker.forEach([&](RE::FormID attacker, const Buffer& buffer) {
+        ok = ok && intfc->WriteRecordData(attacker) && writeBuffer(intfc, buffer);
+    });
+
+    if (!ok)
+        logger::warn("Failed to save play history!");
+}
+
+void PlayHistory::load(SKSE::SerializationInterface* intfc, uint32_t version)
+{
+    clear();
+    if (version != record_version)
+    {
+        logger::warn("Unknown play history version {}, discarded.", version);
+        return;
+    }
+
+    uint32_t attacker_count = 0;
+    bool     ok             = readBuffer(intfc, global) && intfc->ReadRecordData(attacker_count);
+    for (uint32_t i = 0; ok && i < attacker_count; ++i)
+    {
+        RE::FormID attacker = 0;
+        Buffer     buffer   = {};
+        ok                  = intfc->ReadRecordData(attacker) && readBuffer(intfc, buffer);
+        if (ok && intfc->ResolveFormID(attacker, attacker))
+            by_attacker.getOrInsert(attacker) = buffer;
+    }
+
+    if (!ok)
+    {
+        logger::warn("Play history record is corrupted, discarded.");
+        clear();
+    }
+}
+} // namespace kaputt
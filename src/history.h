@@ -0,0 +1,41 @@
+#pragma once
+
+#include "containers.h"
+
+namespace kaputt
+{
+// Recently played paired idles, globally and per attacker. Saved with the game.
+class PlayHistory
+{
+public:
+    static constexpr size_t capacity = 16; // per buffer
+
+    static PlayHistory* getSingleton()
+    {
+        static PlayHistory history;
+        return std::addressof(history);
+    }
+
+    void record(const RE::Actor* attacker, RE::FormID idle);
+    void clear();
+
+    // newest first, up to depth global and attacker_depth per-attacker entries, returns the count written
+    size_t getRecent(const RE::Actor* attacker, size_t depth, size_t attacker_depth, std::span<RE::FormID> out) const;
+
+    // co-save
+    void save(SKSE::SerializationInterface* intfc) const;
+    void load(SKSE::SerializationInterface* intfc, uint32_t version);
+
+    static constexpr uint32_t record_type    = 'HIST';
+    static constexpr uint32_t record_version = 1;
+
+private:
+    using Buffer = RingBuffer<RE::FormID, capacity>;
+
+    Buffer                 global      = {};
+    FormTable<Buffer, 128> by_attacker = {}; // up to 96 attackers
+
+    static bool writeBuffer(SKSE::SerializationInterface* intfc, const Buffer& buffer);
+    static bool readBuffer(SKSE::SerializationInterface* intfc, Buffer& buffer);
+};
+} // namespace kaputt
@@ -0,0 +1,110 @@
+#include "hotreload.h"
+
+#include "kaputt.h"
+#include "menu.h"
+
+namespace fs = std::filesystem;
+
+namespace kaputt
+{
+std::optional<HotReload::FileStamp> HotReload::stamp(const fs::path& path)
+{
+    std::error_code ec;
+    FileStamp       result;
+    result.mtime = fs::last_write_time(path, ec);
+    if (ec)
+        return std::nullopt;
+    result.size = fs::file_size(path, ec);
+    if (ec)
+        return std::nullopt;
+    return result;
+}
+
+StrMap<HotReload::FileStamp> HotReload::scanPacks()
+{
+    StrMap<FileStamp> stamps = {};
+
+    std::error_code ec;
+    for (auto const& dir_entry : fs::directory_iterator{anim_dir, ec})
+        if (dir_entry.is_regular_file(ec))
+            if (auto file_path = dir_entry.path(); file_path.extension() == ".json")
+                if (auto file_stamp = stamp(file_path); file_stamp)
+                    stamps.emplace(file_path.filename().string(), *file_stamp);
+
+    return stamps;
+}
+
+void HotReload::snapshot()
+{
+    pack_stamps = scanPacks();
+    {
+        std::scoped_lock l(self_write_lock);
+        config_stamp     = stamp(def_config_path).value_or(FileStamp{});
+        self_write_stamp = std::nullopt;
+    }
+    next_poll = std::chrono::steady_clock::now() + poll_interval;
+}
+
+void HotReload::recordSelfWrite([[maybe_unused]] const std::unique_lock<std::mutex>& lock)
+{
+    self_write_stamp = stamp(def_config_path);
+}
+
+void HotReload::update()
+{
+    auto kaputt = Kaputt::getSingleton();
+    if (!kaputt->isReady() || !kaputt->misc_params.hot_reload)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_poll)
+        return;
+    next_poll = now + poll_interval;
+
+    auto new_stamps = scanPacks();
+
+    size_t changed = 0;
+    for (auto const& [pack, old_stamp] : pack_stamps)
+        if (!new_stamps.contains(pack))
+        {
+            logger::info("Animation pack {} removed.", pack);
+            kaputt->unloadAnimPack(pack);
+            ++changed;
+        }
+    for (auto const& [pack, new_stamp] : new_stamps)
+        if (auto old_stamp = pack_stamps.find(pack); (old_stamp == pack_stamps.end()) || (old_stamp->second != new_stamp))
+        {
+            logger::info("Animation pack {} changed.", pack);
+            kaputt->loadAnimPack(fs::path{anim_dir} / pack);
+            ++changed;
+        }
+    pack_stamps = std::move(new_stamps);
+
+    if (changed)
+        setStatusMessage(std::format("Reloaded {} animation pack(s).", changed));
+
+    FileStamp new_config_stamp = {};
+    bool      self_written     = false;
+    {
+        std::scoped_lock l(self_write_lock);
+        new_config_stamp = stamp(def_config_path).value_or(FileStamp{});
+        self_written     = (self_write_stamp == new_config_stamp);
+        if (new_config_stamp != config_stamp)
+            self_write_stamp = std::nullopt;
+    }
+    if (new_config_stamp != config_stamp)
+    {
+        config_stamp = new_config_stamp;
+        if (self_written) // saved by kaputt, nothing to reload
+            return;
+        logger::info("{} changed.", def_config_path);
+        if (kaputt->loadConfig(def_config_path))
+        {
+            kaputt->applyRefs();
+            setStatusMessage("Reloaded kaputt config.");
+        }
+        else
+            setStatusMessage("Something wrong while reloading kaputt config. Please check the log.");
+    }
+}
+} // namespace kaputt
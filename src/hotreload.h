@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+
+namespace kaputt
+{
+// Polls the animation folder and kaputt.json for changes, so packs can be edited while the game is running.
+class HotReload
+{
+public:
+    static HotReload* getSingleton()
+    {
+        static HotReload hot_reload;
+        return std::addressof(hot_reload);
+    }
+
+    void snapshot(); // take the current files as baseline without reloading anything
+    void update();   // called every frame, only touches the disk once per poll_interval
+
+    // For kaputt's own writes of kaputt.json, from any thread. Hold the lock from replacing the file until
+    // recordSelfWrite, so the poll never sees the file before its stamp is known. Only that stamp is skipped.
+    [[nodiscard]] std::unique_lock<std::mutex> lockSelfWrite() { return std::unique_lock{self_write_lock}; }
+    void                                       recordSelfWrite(const std::unique_lock<std::mutex>& lock);
+
+private:
+    struct FileStamp
+    {
+        std::filesystem::file_time_type mtime = {};
+        std::uintmax_t                  size  = 0;
+
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    static constexpr auto poll_interval = std::chrono::seconds(1);
+
+    std::chrono::steady_clock::time_point next_poll    = {};
+    StrMap<FileStamp>                     pack_stamps  = {};
+    FileStamp                             config_stamp = {};
+
+    std::mutex               self_write_lock  = {};
+    std::optional<FileStamp> self_write_stamp = std::nullopt; // guarded by self_write_lock
+
+    static std::optional<FileStamp> stamp(const std::filesystem::path& path);
+    StrMap<FileStamp>               scanPacks();
+};
+} // namespace kaputt
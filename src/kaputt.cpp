@@ -1,14 +1,20 @@
 #include "kaputt.h"
 
 #include "re.h"
+#include "menu.h"
 #include "utils.h"
 #include "trigger.h"
+#include "hotreload.h"
+#include "configwriter.h"
+#include "history.h"
+#include "random.h"
+#include "probability.h"
+#include "failcache.h"
+#include "conditions.h"
 
 #include <filesystem>
 namespace fs = std::filesystem;
 
-#include <effolkronium/random.hpp>
-
 namespace kaputt
 {
 bool Kaputt::loadRefs()
@@ -24,6 +30,10 @@ bool Kaputt::loadRefs()
     required_refs.decap_bleed_ignore_perk = RE::TESForm::LookupByEditorID<RE::TESGlobal>("KapBleedIgnoreDecapPerk");
     required_refs.decap_percent           = RE::TESForm::LookupByEditorID<RE::TESGlobal>("KapDecapPercent");
     required_refs.decap_use_chance        = RE::TESForm::LookupByEditorID<RE::TESGlobal>("KapDecapUseChance");
+
+    if (required_refs.idle_kaputt_root && required_refs.idle_kaputt_root->childIdles)
+        TaggerCache::getSingleton()->analyze(*required_refs.idle_kaputt_root->childIdles);
+
     return required_refs.vanilla_killmove &&
         required_refs.idle_kaputt_root &&
         required_refs.decap_disable_player &&
@@ -60,6 +70,8 @@ bool Kaputt::init()
 
     all_ok &= loadAnims();
     all_ok &= loadConfig(def_config_path);
+    updateAnimIndex(); // with the config's overrides
+    HotReload::getSingleton()->snapshot();
 
     ready.store(true);
     logger::info("Kaputt initialized.");
@@ -67,38 +79,537 @@ bool Kaputt::init()
     return all_ok;
 }
 
-std::vector<std::string_view> Kaputt::listAnims(std::string_view filter_str, int filter_mode)
+void Kaputt::buildEdidIndex(std::shared_ptr<const AnimIndex> index)
+{
+    edid_index_keys = std::move(index);
+
+    std::vector<std::string_view> edids;
+    edids.reserve(edid_index_keys->size());
+    for (uint32_t anim_idx = 0; anim_idx < edid_index_keys->size(); ++anim_idx)
+        edids.push_back(edid_index_keys->getEdid(anim_idx)); // key indices are anim indices while the pack generation is the same
+    edid_index.build(std::move(edids));
+}
+
+void Kaputt::publishAnimIndex(std::shared_ptr<const AnimIndex> index)
+{
+    std::scoped_lock l(index_lock);
+    anim_index = std::move(index);
+    query_cache.clear(); // the sampler is reset by the next pick
+}
+
+void Kaputt::updateAnimIndex()
 {
-    std::vector<std::string_view> retval;
-    for (auto const& [edid, _] : anim_tags_map)
+    auto generation = tags_generation.load();
+    if (anim_index->generation == generation) // only this thread publishes
+        return;
+
+    auto index = std::make_shared<AnimIndex>(*anim_index); // same anims, the overrides are applied again
+    applyOverrides(*index);
+    index->generation = generation;
+    publishAnimIndex(std::move(index));
+}
+
+void Kaputt::applyOverrides(AnimIndex& index) const
+{
+    auto anim_count = index.size();
+
+    // tag ids first, the matrices are as wide as the tag table
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> custom_tags;
+    for (auto const& [edid, tags] : anim_custom_tags_map)
+        if (auto anim_idx = index.find(edid); anim_idx)
+        {
+            auto& [_, tag_ids] = custom_tags.emplace_back(*anim_idx, std::vector<uint32_t>{});
+            for (auto const& tag : tags)
+                tag_ids.push_back(index.tags.intern(tag));
+        }
+    std::ranges::sort(custom_tags, {}, &std::pair<uint32_t, std::vector<uint32_t>>::first);
+
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> expansions;
+    for (auto const& [from, to] : tagexp_list)
+        if (auto from_id = index.tags.find(from); from_id)
+        {
+            auto& [_, to_ids] = expansions.emplace_back(*from_id, std::vector<uint32_t>{});
+            for (auto const& tag : to)
+                to_ids.push_back(index.tags.intern(tag));
+        }
+
+    index.tag_bits.assign(anim_count, index.tags.size());
+    index.exp_bits.assign(anim_count, index.tags.size());
+    auto custom = custom_tags.begin();
+    for (uint32_t anim_idx = 0; anim_idx < anim_count; ++anim_idx)
     {
-        if ((filter_mode == 1) && !edid.contains(filter_str))
-            continue;
-        if ((filter_mode == 2) && !std::ranges::all_of(splitTags(filter_str), [&](const std::string& tag) { return getTags(edid).contains(tag); }))
-            continue;
-        retval.push_back(edid);
+        auto set = [&](uint32_t tag_id) {
+            index.tag_bits.set(anim_idx, tag_id);
+            index.exp_bits.set(anim_idx, tag_id);
+        };
+        if ((custom != custom_tags.end()) && (custom->first == anim_idx))
+            std::ranges::for_each((custom++)->second, set);
+        else
+            index.pack_bits[anim_idx].forEach(set);
+
+        for (auto const& [from_id, to_ids] : expansions)
+            if (index.tag_bits[anim_idx].test(from_id)) // expanded only once
+                for (auto tag_id : to_ids)
+                    index.exp_bits.set(anim_idx, tag_id);
     }
-    return retval;
+
+    index.custom_tags.assign(anim_count, false);
+    for (auto const& [anim_idx, _] : custom_tags)
+        index.custom_tags[anim_idx] = true;
+
+    index.weights = index.pack_weights;
+    index.custom_weights.assign(anim_count, false);
+    for (auto const& [edid, weight] : anim_custom_weights)
+        if (auto anim_idx = index.find(edid); anim_idx)
+        {
+            index.weights[*anim_idx]        = weight;
+            index.custom_weights[*anim_idx] = true;
+        }
+    index.uniform = std::ranges::adjacent_find(index.weights, std::ranges::not_equal_to{}) == index.weights.end();
+
+    index.tag_expansions  = tagexp_list;
+    index.override_memory = heapSize(anim_custom_tags_map) + heapSize(anim_custom_weights);
+    index.buildCoverage(skeleton_tags);
+}
+
+// Builds the index again with the packs' anims in place of what they had registered. Anims of the
+// other packs stay, and between packs the first to register an edid keeps it. tags is a copy of the
+// current table the packs were read with.
+StrSet Kaputt::registerPacks(std::vector<PackRead> packs, TagTable tags)
+{
+    auto const& old      = *anim_index;
+    auto        replaced = [&](std::string_view pack) { return std::ranges::any_of(packs, [&](auto const& read) { return read.name == pack; }); };
+
+    struct Row
+    {
+        std::string_view edid;
+        uint32_t         old_idx; // of a kept anim
+        const PackAnim*  anim;    // of a read one, nullptr if kept
+        uint16_t         pack_id; // in the new index
+    };
+
+    auto index = std::make_shared<AnimIndex>();
+    auto rows  = std::vector<Row>{};
+    rows.reserve(old.size());
+
+    std::vector<uint16_t> old_pack_ids(old.pack_names.size(), AnimIndex::no_pack);
+    for (uint16_t pack_id = 0; pack_id < old.pack_names.size(); ++pack_id)
+        if (!replaced(old.pack_names[pack_id]))
+        {
+            old_pack_ids[pack_id] = static_cast<uint16_t>(index->pack_names.size());
+            index->pack_names.push_back(old.pack_names[pack_id]);
+        }
+    for (uint32_t anim_idx = 0; anim_idx < old.size(); ++anim_idx)
+        if (auto pack_id = old.pack_ids[anim_idx]; (pack_id == AnimIndex::no_pack) || (old_pack_ids[pack_id] != AnimIndex::no_pack))
+            rows.push_back({old.getEdid(anim_idx), anim_idx, nullptr, (pack_id == AnimIndex::no_pack) ? pack_id : old_pack_ids[pack_id]});
+
+    std::vector<uint16_t> read_ids(packs.size(), AnimIndex::no_pack);
+    for (size_t i = 0; i < packs.size(); ++i)
+        if (!packs[i].anims.empty())
+        {
+            read_ids[i] = static_cast<uint16_t>(index->pack_names.size());
+            index->pack_names.push_back(packs[i].name);
+            for (auto const& anim : packs[i].anims)
+                rows.push_back({anim.edid, 0, &anim, read_ids[i]});
+        }
+
+    // the kept anims and the packs in load order, so the first of equal edids is the one that registered first
+    std::vector<StrSet> shadowed(packs.size());
+    std::ranges::stable_sort(rows, {}, &Row::edid);
+    size_t kept = 0;
+    for (auto const& row : rows)
+        if ((kept == 0) || (rows[kept - 1].edid != row.edid))
+            rows[kept++] = row;
+        else if (auto read = std::ranges::find(read_ids, row.pack_id); read != read_ids.end())
+            shadowed[read - read_ids.begin()].emplace(row.edid);
+    rows.resize(kept);
+
+    auto anim_count = rows.size();
+    index->edid_offsets.reserve(anim_count + 1);
+    index->pack_bits.assign(anim_count, tags.size());
+    index->pack_weights.reserve(anim_count);
+    index->idles.reserve(anim_count);
+    index->pack_ids.reserve(anim_count);
+    for (uint32_t anim_idx = 0; anim_idx < anim_count; ++anim_idx)
+    {
+        auto const& row = rows[anim_idx];
+        index->edid_pool.append(row.edid).push_back('\0');
+        index->edid_offsets.push_back(static_cast<uint32_t>(index->edid_pool.size()));
+        index->pack_ids.push_back(row.pack_id);
+
+        if (row.anim)
+        {
+            for (auto tag_id : row.anim->tag_ids)
+                index->pack_bits.set(anim_idx, tag_id);
+            index->pack_weights.push_back(row.anim->weight);
+            index->idles.push_back(row.anim->idle);
+        }
+        else // the copied table keeps the old ids
+        {
+            old.pack_bits[row.old_idx].forEach([&](uint32_t tag_id) { index->pack_bits.set(anim_idx, tag_id); });
+            index->pack_weights.push_back(old.pack_weights[row.old_idx]);
+            index->idles.push_back(old.idles[row.old_idx]);
+        }
+        if (auto idle = index->idles.back(); idle)
+            index->form_ids.emplace_back(idle->GetFormID(), anim_idx);
+    }
+    index->edid_pool.shrink_to_fit();
+    std::ranges::sort(index->form_ids);
+    index->tags = std::move(tags);
+
+    StrSet freed = {};
+    for (uint32_t anim_idx = 0; anim_idx < old.size(); ++anim_idx)
+        if (replaced(old.getPack(anim_idx)) && !index->find(old.getEdid(anim_idx)))
+            freed.emplace(old.getEdid(anim_idx));
+
+    for (size_t i = 0; i < packs.size(); ++i)
+    {
+        auto registered = (read_ids[i] == AnimIndex::no_pack) ? 0 : std::ranges::count(index->pack_ids, read_ids[i]);
+        if (!packs[i].anims.empty())
+            logger::info("Registered {} animations from {}, {} taken by other packs", registered, packs[i].name, shadowed[i].size());
+        anim_pack_shadows.insert_or_assign(packs[i].name, std::move(shadowed[i]));
+    }
+
+    applyOverrides(*index);
+    index->generation      = ++tags_generation;
+    index->pack_generation = index->generation;
+    logger::debug("Anim index built, {} anims, {} tags, {} KB", anim_count, index->tags.size(), index->memoryUsage() / 1024);
+
+    publishAnimIndex(std::move(index));
+    FailureCache::getSingleton()->clear();
+    return freed;
+}
+
+std::shared_ptr<const AnimIndex> Kaputt::getAnimIndex() const
+{
+    std::scoped_lock l(index_lock);
+    return anim_index;
+}
+
+bool Kaputt::isCovered(const RE::Actor* attacker, const RE::Actor* victim)
+{
+    return getAnimIndex()->isCovered(getSkeletonId(attacker), getSkeletonId(victim));
+}
+
+// Weighted pick over the candidates. Recently played anims are redrawn a few times,
+// so the candidate set stays the same and its alias table can be reused.
+uint32_t Kaputt::pickAnim(const AnimIndex& index, std::vector<uint32_t>& anims, uint64_t set_key, std::span<const RE::FormID> recent_ids, Rng& rng)
+{
+    constexpr size_t max_redraws = 8;
+
+    std::scoped_lock l(sampler_lock);
+    if (sampler_gen != index.generation) // tables over another index
+    {
+        sampler.clear();
+        sampler_gen = index.generation;
+    }
+
+    auto table = index.uniform ? nullptr : sampler.getTable(set_key, anims, index.weights); // counted once per submit
+    auto pick  = [&]() {
+        return index.uniform ? anims[rng.bounded(static_cast<uint32_t>(anims.size()))] : sampler.pick(table, anims, index.weights, rng);
+    };
+
+    // recent anims that are among the candidates, anims is sorted
+    std::array<uint32_t, 2 * PlayHistory::capacity> recent   = {};
+    size_t                                          n_recent = 0;
+    for (size_t i = 0; i < std::min(recent_ids.size(), recent.size()); ++i)
+        if (auto anim_idx = index.findForm(recent_ids[i]); anim_idx && std::ranges::binary_search(anims, *anim_idx))
+            if (std::find(recent.begin(), recent.begin() + n_recent, *anim_idx) == recent.begin() + n_recent)
+                recent[n_recent++] = *anim_idx;
+
+    auto isRecent = [&](uint32_t anim_idx) { return std::find(recent.begin(), recent.begin() + n_recent, anim_idx) != recent.begin() + n_recent; };
+
+    auto anim_idx = pick();
+    if (n_recent == anims.size()) // nothing else to play
+        return anim_idx;
+
+    for (size_t i = 0; i < max_redraws && isRecent(anim_idx); ++i)
+        anim_idx = pick();
+    if (isRecent(anim_idx))
+    {
+        std::erase_if(anims, isRecent);
+        table    = nullptr; // not the keyed set anymore
+        anim_idx = pick();
+    }
+
+    logger::debug("Avoided {} recent anims", n_recent);
+    return anim_idx;
 }
 
-const StrSet& Kaputt::getTags(std::string_view edid)
+std::shared_ptr<const CompiledQuery> Kaputt::compileQuery(const AnimIndex& index, std::string_view query_str)
 {
-    auto result_tags        = anim_tags_map.find(edid);
-    auto result_custom_tags = anim_custom_tags_map.find(edid);
-    return (result_custom_tags == anim_custom_tags_map.end()) ? result_tags->second : result_custom_tags->second;
+    {
+        std::scoped_lock l(index_lock);
+        if (anim_index.get() == &index)
+            if (auto it = query_cache.find(query_str); it != query_cache.end())
+                return it->second;
+    }
+
+    auto result = TagQuery::parse(query_str);
+    if (result.index() == 1)
+    {
+        logger::debug("Invalid tag query \"{}\": {}", query_str, std::get<1>(result));
+        return nullptr;
+    }
+
+    auto query = std::make_shared<const CompiledQuery>(std::get<0>(result).compile(index.tags));
+
+    std::scoped_lock l(index_lock);
+    if (anim_index.get() != &index) // replaced meanwhile, the cache is for the new one
+        return query;
+    if (query_cache.size() >= 64) // only a handful are ever in use at once
+        query_cache.clear();
+    query_cache.emplace(std::string{query_str}, query);
+    return query;
+}
+
+std::vector<uint32_t> Kaputt::listAnims(const std::shared_ptr<const AnimIndex>& index, std::string_view filter_str, int filter_mode)
+{
+    std::vector<uint32_t> retval = {};
+
+    if (filter_mode == 1)
+    {
+        if (!edid_index_keys || (edid_index_keys->pack_generation != index->pack_generation))
+            buildEdidIndex(index);
+        return edid_index.find(filter_str);
+    }
+
+    if (filter_mode == 2)
+    {
+        auto query = compileQuery(*index, filter_str);
+        if (!query)
+            return retval;
+
+        for (uint32_t anim_idx = 0; anim_idx < index->size(); ++anim_idx)
+            if (query->eval(index->tag_bits[anim_idx]))
+                retval.push_back(anim_idx);
+        return retval;
+    }
+
+    retval.resize(index->size());
+    std::iota(retval.begin(), retval.end(), 0u);
+    return retval;
 }
 
 bool Kaputt::setTags(std::string_view edid, const StrSet& tags)
 {
-    if (auto result_tags = anim_tags_map.find(edid); result_tags != anim_tags_map.end())
+    if (anim_index->find(edid))
     {
         anim_custom_tags_map.insert_or_assign(std::string{edid}, tags);
+        ++tags_generation;
+        return true;
+    }
+    else
+        return false;
+}
+
+void Kaputt::resetTags(std::string_view edid)
+{
+    if (auto result_custom_tags = anim_custom_tags_map.find(edid); result_custom_tags != anim_custom_tags_map.end())
+    {
+        anim_custom_tags_map.erase(result_custom_tags);
+        ++tags_generation;
+    }
+}
+
+bool Kaputt::setWeight(std::string_view edid, float weight)
+{
+    if (anim_index->find(edid))
+    {
+        anim_custom_weights.insert_or_assign(std::string{edid}, std::max(weight, 0.f));
+        ++tags_generation;
         return true;
     }
     else
         return false;
 }
 
+void Kaputt::resetWeight(std::string_view edid)
+{
+    if (auto result = anim_custom_weights.find(edid); result != anim_custom_weights.end())
+    {
+        anim_custom_weights.erase(result);
+        ++tags_generation;
+    }
+}
+
+void Kaputt::setTagExpansions(StrMap<StrSet> expansions)
+{
+    tagexp_list = std::move(expansions);
+    ++tags_generation;
+}
+
+/* Streams one animation pack into PackAnims, with the tags interned as they are read, so no
+ * json DOM or per-anim tag strings are built. An edid given twice in one file takes its last
+ * entry, as the json DOM did.
+ * Expected layout, both entry forms can be mixed:
+ *  {
+ *      "edid": ["tag", ...],
+ *      "edid": {"tags": ["tag", ...], "weight": 0.5}
+ *  }
+ */
+class AnimPackSax : public nlohmann::json_sax<json>
+{
+public:
+    AnimPackSax(TagTable& tags, std::vector<PackAnim>& anims) :
+        tags(tags), anims(anims) {}
+
+    bool missing_forms = false;
+
+    bool null() { return typeError("null"); }
+    bool boolean(bool) { return typeError("boolean"); }
+    bool number_integer(number_integer_t val) { return number(static_cast<float>(val)); }
+    bool number_unsigned(number_unsigned_t val) { return number(static_cast<float>(val)); }
+    bool number_float(number_float_t val, const string_t&) { return number(static_cast<float>(val)); }
+    bool binary(binary_t&) { return typeError("binary"); }
+
+    bool string(string_t& val)
+    {
+        if (!inTagList())
+            return typeError("string");
+        entry.tag_ids.push_back(tags.intern(val));
+        return true;
+    }
+
+    bool start_object(std::size_t)
+    {
+        if (depth == 1) // {"tags": [], "weight": 1}
+        {
+            resetEntry();
+            field = {};
+        }
+        else if (depth != 0)
+            return typeError("object");
+        ++depth;
+        return true;
+    }
+    bool end_object()
+    {
+        if (--depth == 1)
+            commit();
+        return true;
+    }
+
+    bool key(string_t& val)
+    {
+        if (depth == 1)
+            edid = std::move(val);
+        else if ((val == "tags") || (val == "weight"))
+            field = std::move(val);
+        else
+            return typeError(std::format("field \"{}\"", val));
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (depth == 1)
+            resetEntry();
+        else if ((depth != 2) || (field != "tags"))
+            return typeError("array");
+        ++depth;
+        return true;
+    }
+    bool end_array()
+    {
+        if (--depth == 1)
+            commit();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e)
+    {
+        if (e.id >= 100 && e.id < 200) // json::parse_error
+            logParseError(static_cast<const json::parse_error&>(e));
+        else
+            logJsonException("StrMap<StrSet>", e);
+        rollback();
+        return false;
+    }
+
+    // the last entry of each edid, call once the parse went through
+    void dropRepeated()
+    {
+        std::ranges::stable_sort(anims, {}, &PackAnim::edid);
+        size_t kept = 0;
+        for (size_t i = 0; i < anims.size(); ++i)
+            if ((i + 1 == anims.size()) || (anims[i + 1].edid != anims[i].edid))
+                anims[kept++] = std::move(anims[i]);
+        anims.resize(kept);
+    }
+
+    // a broken file registers nothing
+    void rollback() { anims.clear(); }
+
+private:
+    TagTable&              tags;
+    std::vector<PackAnim>& anims;
+
+    StrMap<const RE::TESFile*> plugins = {}; // by name, nullptr if not loaded
+
+    int         depth = 0;
+    std::string edid  = {}; // editor id or "Plugin.esp|0x00ABCD"
+    std::string field = {}; // inside an object entry
+    PackAnim    entry = {};
+
+    // tags are at depth 2 in the array form, depth 3 in the object form
+    bool inTagList() const { return (depth == 2 && field.empty()) || (depth == 3); }
+
+    bool number(float val)
+    {
+        if ((depth != 2) || (field != "weight"))
+            return typeError("number");
+        entry.weight = std::max(val, 0.f);
+        return true;
+    }
+
+    RE::TESIdleForm* resolveIdle(std::string_view ref)
+    {
+        auto form_ref = parseFormRef(ref);
+        if (!form_ref)
+            return RE::TESForm::LookupByEditorID<RE::TESIdleForm>(ref);
+
+        auto [it, added] = plugins.try_emplace(std::string{form_ref->first}, nullptr);
+        if (added)
+            it->second = RE::TESDataHandler::GetSingleton()->LookupModByName(form_ref->first);
+        if (!it->second || (it->second->compileIndex == 0xFF))
+            return nullptr;
+        return RE::TESForm::LookupByID<RE::TESIdleForm>(getFullFormID(it->second, form_ref->second));
+    }
+
+    void resetEntry() { entry = {}; }
+
+    void commit()
+    {
+        field     = {};
+        auto idle = resolveIdle(edid);
+        if (!idle)
+        {
+            logger::warn("Cannot find IdleForm {}!", edid);
+            missing_forms = true;
+            return;
+        }
+        // form references are registered under the editor id when there is one
+        entry.edid = idle->GetFormEditorID();
+        if (entry.edid.empty())
+            entry.edid = edid;
+        entry.idle = idle;
+        std::ranges::sort(entry.tag_ids);
+        entry.tag_ids.erase(std::ranges::unique(entry.tag_ids).begin(), entry.tag_ids.end());
+        anims.push_back(std::move(entry));
+        resetEntry();
+    }
+
+    bool typeError(std::string_view type)
+    {
+        logger::warn("Error while deserializing StrMap<StrSet>\n"
+                     "\tunexpected {} for entry {}",
+                     type, edid);
+        rollback();
+        return false;
+    }
+};
+
 bool Kaputt::loadAnims()
 {
     logger::info("Loading animation entries...");
@@ -111,72 +622,80 @@ bool Kaputt::loadAnims()
         return false;
     }
 
+    auto start_time = std::chrono::steady_clock::now();
+
+    // read them all, then build the index once
+    auto                  tags  = anim_index->tags;
+    std::vector<PackRead> packs = {};
     for (auto const& dir_entry : fs::directory_iterator{anim_dir})
         if (dir_entry.is_regular_file())
             if (auto file_path = dir_entry.path(); file_path.extension() == ".json")
             {
-                logger::info("Reading {}", file_path.string());
+                auto& pack = packs.emplace_back(PackRead{file_path.filename().string()});
+                all_ok &= readAnimPack(file_path, tags, pack) && !pack.missing_forms;
+            }
+    registerPacks(std::move(packs), std::move(tags));
 
-                std::ifstream istream{file_path};
-                if (!istream.is_open())
-                {
-                    logger::warn("Failed to open {}", file_path.filename().string());
-                    all_ok = false;
-                    continue;
-                }
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time);
+    logger::info("All animation entries loaded in {:.1f} ms. Total animation count: {}", elapsed.count(), anim_index->size());
+    return all_ok;
+}
 
-                json j;
-                try
-                {
-                    j = json::parse(istream);
-                }
-                catch (json::parse_error& e)
-                {
-                    logParseError(e);
-                    all_ok = false;
-                    continue;
-                }
+bool Kaputt::readAnimPack(const fs::path& file_path, TagTable& tags, PackRead& pack)
+{
+    logger::info("Reading {}", file_path.string());
 
-                StrMap<StrSet> new_tags = {};
-                try
-                {
-                    new_tags = j;
-                }
-                catch (json::exception& e)
-                {
-                    logJsonException("StrMap<StrSet>", e);
-                    all_ok = false;
-                    continue;
-                }
-                std::erase_if(new_tags, [&](const auto& item) {
-                    auto const& [edid, tags] = item;
-                    auto form                = RE::TESForm::LookupByEditorID<RE::TESIdleForm>(edid);
-                    if (!form)
-                    {
-                        logger::warn("Cannot find IdleForm {}!", edid);
-                        all_ok = false;
-                        return true;
-                    }
-                    return false;
-                });
+    std::ifstream istream{file_path};
+    if (!istream.is_open())
+    {
+        logger::warn("Failed to open {}", file_path.filename().string());
+        return false;
+    }
 
-                auto anim_count = new_tags.size();
-                anim_tags_map.merge(new_tags);
+    AnimPackSax sax{tags, pack.anims};
+    if (!json::sax_parse(istream, &sax))
+        return false;
+    sax.dropRepeated();
+    pack.missing_forms = sax.missing_forms;
+    return true;
+}
 
-                logger::info("Successfully registered {} animations in {}", anim_count, file_path.filename().string());
-            }
+bool Kaputt::loadAnimPack(const fs::path& file_path)
+{
+    auto                  tags  = anim_index->tags;
+    std::vector<PackRead> packs = {PackRead{file_path.filename().string()}};
+    if (!readAnimPack(file_path, tags, packs.front())) // the version registered before stays
+        return false;
 
-    logger::info("All animation entries loaded. Total animation count: {}", anim_tags_map.size());
-    return all_ok;
+    bool ok = !packs.front().missing_forms;
+    restoreShadowed(registerPacks(std::move(packs), std::move(tags))); // what the new version no longer defines
+    return ok;
 }
 
-bool Kaputt::loadConfig(std::string_view dir)
+void Kaputt::unloadAnimPack(std::string_view pack)
 {
-    clear();
+    auto freed = registerPacks({PackRead{std::string{pack}}}, anim_index->tags);
+    anim_pack_shadows.erase(pack);
+    logger::info("Unregistered {} animations from {}", freed.size(), pack);
+    restoreShadowed(freed);
+}
+
+// Another pack's definitions of the edids, if it has some and nobody holds them now.
+void Kaputt::restoreShadowed(const StrSet& edids)
+{
+    std::vector<std::string> shadowing = {};
+    for (auto const& [pack, shadowed] : anim_pack_shadows)
+        if (std::ranges::any_of(edids, [&](auto const& edid) { return shadowed.contains(edid) && !anim_index->find(edid); }))
+            shadowing.push_back(pack);
+
+    for (auto const& pack : shadowing) // its other anims are registered as they were
+        loadAnimPack(fs::path{anim_dir} / pack);
+}
 
+bool Kaputt::loadConfig(std::string_view dir)
+{
     logger::info("Loading kaputt config {} ...", dir);
 
-    bool all_ok = true;
     if (fs::path file_path = dir; file_path.extension() == ".json")
     {
         logger::info("Reading {}", file_path.string());
@@ -201,30 +720,7 @@ bool Kaputt::loadConfig(std::string_view dir)
             return false;
         }
 
-        try
-        {
-            from_json(j, *this);
-            from_json(j["triggers"]["vanilla"], *VanillaTrigger::getSingleton());
-            from_json(j["triggers"]["post_hit"], *PostHitTrigger::getSingleton());
-            from_json(j["triggers"]["sneak"], *SneakTrigger::getSingleton());
-        }
-        catch (json::exception e)
-        {
-            logJsonException("Kaputt", e);
-            logger::warn("Kaputt config not fully loaded!");
-            return false;
-        }
-
-        if (misc_params.enable_debug_log)
-        {
-            spdlog::set_level(spdlog::level::trace);
-            spdlog::flush_on(spdlog::level::trace);
-        }
-        else
-        {
-            spdlog::set_level(spdlog::level::info);
-            spdlog::flush_on(spdlog::level::info);
-        }
+        return applyConfig(j);
     }
     else
     {
@@ -232,34 +728,64 @@ bool Kaputt::loadConfig(std::string_view dir)
         logger::warn("Kaputt config not loaded!");
         return false;
     }
+}
+
+bool Kaputt::applyConfig(const json& j)
+{
+    clear();
+
+    try
+    {
+        from_json(j, *this);
+        anim_custom_weights = j.value("anim_custom_weights", StrMap<float>{}); // optional, older configs lack it
+        from_json(j["triggers"]["vanilla"], *VanillaTrigger::getSingleton());
+        from_json(j["triggers"]["post_hit"], *PostHitTrigger::getSingleton());
+        from_json(j["triggers"]["sneak"], *SneakTrigger::getSingleton());
+        ProbabilityModel::getSingleton()->params = j["triggers"].value("probability", ProbabilityParams{}); // optional
+        ProbabilityModel::getSingleton()->markDirty();
+    }
+    catch (json::exception e)
+    {
+        logJsonException("Kaputt", e);
+        logger::warn("Kaputt config not fully loaded!");
+        return false;
+    }
+
+    RandomStreams::getSingleton()->setDeterministic(misc_params.deterministic);
+    FailureCache::getSingleton()->clear();
+
+    if (misc_params.enable_debug_log)
+    {
+        spdlog::set_level(spdlog::level::trace);
+        spdlog::flush_on(spdlog::level::trace);
+    }
+    else
+    {
+        spdlog::set_level(spdlog::level::info);
+        spdlog::flush_on(spdlog::level::info);
+    }
 
     logger::info("Kaputt config loaded.");
-    return all_ok;
+    return true;
 }
 
 bool Kaputt::saveConfig(std::string_view dir)
 {
     logger::info("Saving kaputt config {} ...", dir);
 
-    bool all_ok = true;
     if (fs::path file_path = dir; file_path.extension() == ".json")
     {
-        logger::info("Reading {}", file_path.string());
-
-        std::ofstream ostream{file_path};
-        if (!ostream.is_open())
-        {
-            logger::warn("Failed to open {}", file_path.filename().string());
-            logger::warn("Kaputt config not saved!");
-            return false;
-        }
-
+        // snapshot here, the dump and disk io happen on the writer thread
         json j = *this;
+        j.emplace("anim_custom_weights", anim_custom_weights);
         j.emplace("triggers", json{});
         j["triggers"].emplace("vanilla", *VanillaTrigger::getSingleton());
         j["triggers"].emplace("post_hit", *PostHitTrigger::getSingleton());
         j["triggers"].emplace("sneak", *SneakTrigger::getSingleton());
-        ostream << j.dump(4);
+        j["triggers"].emplace("probability", ProbabilityModel::getSingleton()->params);
+
+        setStatusMessage(std::format("Saving config to {} ...", dir));
+        ConfigWriter::getSingleton()->queue(std::move(file_path), std::move(j));
     }
     else
     {
@@ -268,18 +794,22 @@ bool Kaputt::saveConfig(std::string_view dir)
         return false;
     }
 
-    logger::info("Kaputt config saved.");
-    return all_ok;
+    return true;
 }
 
 bool Kaputt::precondition(const RE::Actor* attacker, const RE::Actor* victim)
+{
+    return checkPrecondition(attacker, victim) == FailReason::kNone;
+}
+
+FailReason Kaputt::checkPrecondition(const RE::Actor* attacker, const RE::Actor* victim)
 {
     logger::debug("> Precondition | Attacker: {} | Victim: {}", attacker->GetName(), victim->GetName());
 
     // Playable check
     logger::debug("playable?");
     if (!(animPlayable(attacker) && animPlayable(victim)))
-        return false;
+        return FailReason::kNotPlayable;
 
     // Essential check
     logger::debug("essential?");
@@ -287,10 +817,10 @@ bool Kaputt::precondition(const RE::Actor* attacker, const RE::Actor* victim)
         switch (precond_params.essential_protection)
         {
             case PreconditionParams::ESSENTIAL_PROT_ENUM::ENABLED:
-                return false;
+                return FailReason::kEssential;
             case PreconditionParams::ESSENTIAL_PROT_ENUM::PROTECTED:
                 if (!attacker->IsPlayerRef())
-                    return false;
+                    return FailReason::kEssential;
                 break;
             default:
                 break;
@@ -299,22 +829,22 @@ bool Kaputt::precondition(const RE::Actor* attacker, const RE::Actor* victim)
     // Protected check
     logger::debug("protected?");
     if (precond_params.protected_protection && victim->IsProtected() && !attacker->IsPlayerRef())
-        return false;
+        return FailReason::kProtected;
 
     // Furniture anim check
     logger::debug("furniture?");
     if (isFurnitureAnimType(victim, RE::BSFurnitureMarker::AnimationType::kSit) && !precond_params.furn_sit)
-        return false;
+        return FailReason::kFurniture;
     if (isFurnitureAnimType(victim, RE::BSFurnitureMarker::AnimationType::kLean) && !precond_params.furn_lean)
-        return false;
+        return FailReason::kFurniture;
     if (isFurnitureAnimType(victim, RE::BSFurnitureMarker::AnimationType::kSleep) && !precond_params.furn_sleep)
-        return false;
+        return FailReason::kFurniture;
 
     // Height diff check
     logger::debug("height diff?");
     if (auto height_diff = victim->GetPositionZ() - attacker->GetPositionZ();
         (height_diff < precond_params.height_diff_range[0]) || (height_diff > precond_params.height_diff_range[1]))
-        return false;
+        return FailReason::kHeight;
 
     // Last hostile check
     logger::debug("last hostile?");
@@ -323,79 +853,129 @@ bool Kaputt::precondition(const RE::Actor* attacker, const RE::Actor* victim)
         attacker->IsPlayerRef() ||
         attacker->GetActorRuntimeData().currentProcess->lowProcessFlags.all(RE::AIProcess::LowProcessFlags::kFollower);
     if (check_last_hostile && !isLastHostileInRange(attacker, victim, precond_params.last_hostile_range))
-        return false;
+        return FailReason::kHostileInRange;
 
     // Race filters
     logger::debug("race?");
     if (std::ranges::any_of(std::array{attacker, victim}, [&](auto actor) { return precond_params.skipped_race.contains(actor->GetRace()->GetFormEditorID()); }))
-        return false;
+        return FailReason::kRace;
 
     // Finally
-    return true;
+    return FailReason::kNone;
 }
 
 bool Kaputt::submit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info)
 {
-    logger::debug("> Filtering | Attacker: {} | Victim: {}", attacker->GetName(), victim->GetName());
-
-    std::vector<std::string_view> anims        = listAnims();
-    StrMap<StrSet>                exp_tags_map = {};
-    for (auto& edid : anims)
-    {
-        StrSet exp_tags  = {};
-        auto&  orig_tags = getTags(edid);
+    return trySubmit(attacker, victim, submit_info) == FailReason::kNone;
+}
 
-        for (const auto& [from, to] : tagexp_list)
-            if (orig_tags.contains(from))
-                mergeSet(exp_tags, to);
-        mergeSet(exp_tags, orig_tags);
+bool Kaputt::submitQuery(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, std::string_view tag_query)
+{
+    return trySubmit(attacker, victim, submit_info, tag_query) == FailReason::kNone;
+}
 
-        exp_tags_map.emplace(edid, std::move(exp_tags));
-    }
+FailReason Kaputt::trySubmit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, std::string_view tag_query)
+{
+    SubmitSnapshot snapshot = {};
+    uint32_t       anim_idx = 0;
+
+    auto reason = snapshotSubmit(attacker, victim, submit_info, tag_query, snapshot);
+    if (reason == FailReason::kNone)
+        reason = filterSubmit(snapshot, anim_idx);
+    if (reason == FailReason::kNone)
+        reason = commitSubmit(snapshot, anim_idx);
+    return reason;
+}
 
-    // manual req and ban
-    std::erase_if(anims, [&](auto& edid) {
-        return std::ranges::any_of(tagging_params.required_tags, [&](auto& tag) { return !exp_tags_map.find(edid)->second.contains(tag); }) ||
-            std::ranges::any_of(submit_info.required_tags, [&](auto& tag) { return !exp_tags_map.find(edid)->second.contains(tag); }) ||
-            std::ranges::any_of(tagging_params.banned_tags, [&](auto& tag) { return exp_tags_map.find(edid)->second.contains(tag); }) ||
-            std::ranges::any_of(submit_info.banned_tags, [&](auto& tag) { return exp_tags_map.find(edid)->second.contains(tag); });
-    });
-    if (anims.empty())
+bool Kaputt::pollSettingsChange()
+{
+    if ((precond_params == seen_precond_params) && (tagging_params == seen_tagging_params) && (tags_generation == seen_tags_gen))
         return false;
+    seen_precond_params = precond_params;
+    seen_tagging_params = tagging_params;
+    seen_tags_gen       = tags_generation;
+    return true;
+}
 
-    // skeleton tag
-    logger::debug("Hardcoded skeleton check. Banning:");
-    auto att_banned_race = getBannedSkels(attacker, "a_");
-    auto vic_banned_race = getBannedSkels(victim, "v_");
-    std::erase_if(anims, [&](auto& edid) {
-        return std::ranges::any_of(att_banned_race, [&](auto& tag) { return exp_tags_map.find(edid)->second.contains(tag); }) ||
-            std::ranges::any_of(vic_banned_race, [&](auto& tag) { return exp_tags_map.find(edid)->second.contains(tag); });
-    });
-    if (spdlog::get_level() == spdlog::level::trace)
+FailReason Kaputt::submitDeferred(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, SubmitWorker::Callback on_done)
+{
+    SubmitSnapshot snapshot = {};
+    if (auto reason = snapshotSubmit(attacker, victim, submit_info, "", snapshot); reason != FailReason::kNone)
+        return reason;
+
+    SubmitWorker::getSingleton()->queue(std::move(snapshot), std::move(on_done));
+    return FailReason::kNone;
+}
+
+// Engine reads of the submit, the IdleTagger results become tag masks.
+FailReason Kaputt::snapshotSubmit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, std::string_view tag_query, SubmitSnapshot& snapshot)
+{
+    logger::debug("> Snapshot | Attacker: {} | Victim: {}", attacker->GetName(), victim->GetName());
+
+    snapshot.attacker = attacker->GetHandle();
+    snapshot.victim   = victim->GetHandle();
+    snapshot.index    = getAnimIndex();
+    auto& index       = *snapshot.index;
+
+    // skeleton tags and weights are settled by the coverage
+    snapshot.att_skel = getSkeletonId(attacker);
+    snapshot.vic_skel = getSkeletonId(victim);
+    if (!index.isCovered(snapshot.att_skel, snapshot.vic_skel))
+        return FailReason::kNoAnimation;
+
+    // manual req and ban
+    auto& req_mask = snapshot.req_mask;
+    auto& ban_mask = snapshot.ban_mask;
+    if (!index.makeMask(tagging_params.required_tags, req_mask) || !index.makeMask(submit_info.required_tags, req_mask))
+        return FailReason::kNoAnimation;
+    index.makeMask(tagging_params.banned_tags, ban_mask);
+    index.makeMask(submit_info.banned_tags, ban_mask);
+
+    snapshot.param_query = compileQuery(index, tagging_params.tag_query);
+    snapshot.info_query  = compileQuery(index, tag_query);
+    if (!snapshot.param_query || !snapshot.info_query)
     {
-        for (const auto& tag : att_banned_race)
-            logger::debug("{}", tag);
-        for (const auto& tag : vic_banned_race)
-            logger::debug("{}", tag);
+        logger::warn("Malformed tag query, nothing will be played.");
+        return FailReason::kOther;
     }
-    if (anims.empty())
-        return false;
 
     // IdleTaggerLOL
     if (required_refs.idle_kaputt_root->childIdles)
     {
-        StrMap<bool>             item_results = {};
-        RE::ConditionCheckParams params(attacker->As<RE::TESObjectREFR>(), victim->As<RE::TESObjectREFR>());
-        for (auto const form : *required_refs.idle_kaputt_root->childIdles)
+        StrMap<bool>       item_results = {};
+        ConditionEvaluator evaluator(attacker, victim, misc_params.validate_conditions);
+        Rng*               decap_rng = nullptr; // GetRandomPercent draws from kaputt's own stream
+        bool               unmatched = false;   // a required tag no anim has
+
+        auto  tagger_cache     = TaggerCache::getSingleton();
+        auto  attacker_results = tagger_cache->load(attacker);
+        auto  victim_results   = tagger_cache->load(victim);
+        auto& items            = *required_refs.idle_kaputt_root->childIdles;
+        for (uint32_t item_idx = 0; item_idx < items.size() && !unmatched; ++item_idx)
         {
-            if (anims.empty()) break;
-
-            auto             idle_form = form->As<RE::TESIdleForm>();
+            auto             idle_form = items[item_idx]->As<RE::TESIdleForm>();
             std::string_view idle_edid = idle_form->GetFormEditorID();
             auto&            flags     = idle_form->data.flags;
 
+            bool has_random = false;
+            for (auto cond_item = idle_form->conditions.head; cond_item != nullptr; cond_item = cond_item->next)
+                has_random |= cond_item->data.functionData.function == RE::FUNCTION_DATA::FunctionID::kGetRandomPercent;
+
+            // single-actor items are reused across pairs
+            auto item_info  = tagger_cache->getInfo(item_idx);
+            auto item_cache = (item_info.deps == ConditionDeps::kAttacker) ? &attacker_results :
+                (item_info.deps == ConditionDeps::kVictim)                 ? &victim_results :
+                                                                             nullptr;
+            auto cached     = item_cache ? item_cache->get(item_idx) : std::nullopt;
+            if (cached)
+                tagger_cache->countHit();
+            else if (item_info.weapon_only) // a lookup on the actor's equipped types
+                cached = evaluator.matchWeapons(item_info, idle_form->conditions);
+
             bool result = true;
-            if (flags.all(RE::IDLE_DATA::Flag::kSequence)) // check each individually
+            if (cached)
+                result = *cached;
+            else if (bool is_sequence = flags.all(RE::IDLE_DATA::Flag::kSequence); is_sequence || has_random) // check each individually
             {
                 bool or_cache = false;
                 for (auto cond_item = idle_form->conditions.head; cond_item != nullptr; cond_item = cond_item->next)
@@ -403,7 +983,7 @@ bool Kaputt::submit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStru
                     auto& cond_data = cond_item->data;
 
                     bool single_result;
-                    if (cond_data.flags.swapTarget && (cond_data.functionData.function == RE::FUNCTION_DATA::FunctionID::kGetGraphVariableInt)) // reference checked item
+                    if (is_sequence && cond_data.flags.swapTarget && (cond_data.functionData.function == RE::FUNCTION_DATA::FunctionID::kGetGraphVariableInt)) // reference checked item
                     {
                         std::string_view ref_item = static_cast<RE::BSString*>(cond_data.functionData.params[0])->c_str();
                         if (item_results.contains(ref_item))
@@ -418,8 +998,14 @@ bool Kaputt::submit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStru
                             logger::warn("One condition from {} requires an unknown item {}.", idle_edid, ref_item);
                         }
                     }
+                    else if (cond_data.functionData.function == RE::FUNCTION_DATA::FunctionID::kGetRandomPercent)
+                    {
+                        if (!decap_rng)
+                            decap_rng = &RandomStreams::getSingleton()->forEvent(RandomStreams::Stream::kDecap);
+                        single_result = compareCondition(static_cast<float>(decap_rng->bounded(100)), cond_data);
+                    }
                     else
-                        single_result = cond_item->IsTrue(params);
+                        single_result = evaluator.isTrue(cond_item);
 
 
                     or_cache |= single_result;
@@ -431,7 +1017,9 @@ bool Kaputt::submit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStru
                 }
             }
             else
-                result = idle_form->conditions.IsTrue(attacker->As<RE::TESObjectREFR>(), victim->As<RE::TESObjectREFR>());
+                result = evaluator.isTrue(idle_form->conditions);
+            if (item_cache && !cached)
+                item_cache->set(item_idx, result, item_info.frame_only);
 
             logger::debug("Tagger item {}, result {}", idle_edid, result);
 
@@ -446,52 +1034,110 @@ bool Kaputt::submit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStru
                     if (flags.all(RE::IDLE_DATA::Flag::kBlocking))
                         std::swap(req_tag, ban_tag);
 
-                    // if ((req_tag == "decap") &&
-                    //     std::ranges::none_of(anims, [&](auto edid) { return exp_tags_map.find(edid)->second.contains("decap"); })) // special treatment for decap
-                    //     continue;
-
-                    std::erase_if(anims, [&](auto edid) {
-                        return (!req_tag.empty() && !exp_tags_map.find(edid)->second.contains(req_tag)) ||
-                            (!ban_tag.empty() && exp_tags_map.find(edid)->second.contains(ban_tag));
-                    });
+                    // a tag no anim has can't be matched by any
+                    auto req_id = req_tag.empty() ? std::nullopt : index.tags.find(req_tag);
+                    auto ban_id = ban_tag.empty() ? std::nullopt : index.tags.find(ban_tag);
+                    unmatched   = !req_tag.empty() && !req_id;
+                    if (req_id)
+                        snapshot.tagger_req_mask.set(*req_id);
+                    if (ban_id)
+                        snapshot.tagger_ban_mask.set(*ban_id);
+                    logger::debug("\t{} {}", req_tag.empty() ? "Banning" : "Requiring", req_tag.empty() ? ban_tag : req_tag);
                 }
-
-                logger::debug("\t{}, {} left", req_tag.empty() ? "Banning" : "Requiring", anims.size());
             }
 
             item_results.emplace(idle_form->GetFormEditorID(), result);
         }
-    }
 
-    logger::debug("Filter over, {} of {} left", anims.size(), anim_tags_map.size());
-    if (anims.empty())
-        return false;
+        tagger_cache->store(attacker, attacker_results);
+        tagger_cache->store(victim, victim_results);
+        if (unmatched)
+            return FailReason::kNoTaggedAnimation;
+    }
 
-    auto edid = anims[effolkronium::random_static::get(0ull, anims.size() - 1)];
-    if (auto idle = RE::TESForm::LookupByEditorID<RE::TESIdleForm>(edid); idle)
+    // the candidate set follows from these, so the sampler can find its table without looking at the set
+    uint64_t set_key = 14695981039346656037ull; // FNV-1a
+    auto     mix     = [&](uint64_t value) { set_key = (set_key ^ value) * 1099511628211ull; };
+    mix(index.generation);
+    mix(snapshot.att_skel);
+    mix(snapshot.vic_skel);
+    for (auto mask : {&snapshot.req_mask, &snapshot.ban_mask, &snapshot.tagger_req_mask, &snapshot.tagger_ban_mask})
     {
-        // preprocess
-        attacker->NotifyAnimationGraph("attackStop");
-        victim->NotifyAnimationGraph("attackStop");
-        attacker->NotifyAnimationGraph("staggerStop");
-        victim->NotifyAnimationGraph("staggerStop");
-        if ((victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kGetUp) ||
-            (victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kQueued))
-        {
-            victim->AsActorState()->actorState1.knockState = RE::KNOCK_STATE_ENUM::kNormal;
-            victim->NotifyAnimationGraph("GetUpEnd");
-        }
+        mix(mask->getWords().size());
+        for (auto word : mask->getWords())
+            mix(word);
+    }
+    mix(std::hash<std::string_view>{}(tagging_params.tag_query));
+    mix(std::hash<std::string_view>{}(tag_query));
+    snapshot.set_key = set_key;
+
+    constexpr int max_depth = static_cast<int>(PlayHistory::capacity);
+    snapshot.recent_count   = PlayHistory::getSingleton()->getRecent(
+        attacker,
+        static_cast<size_t>(std::clamp(tagging_params.avoid_recent, 0, max_depth)),
+        static_cast<size_t>(std::clamp(tagging_params.avoid_recent_attacker, 0, max_depth)),
+        snapshot.recent_ids);
+    snapshot.rng.seed(RandomStreams::getSingleton()->forEvent(RandomStreams::Stream::kSelection).next());
+
+    return FailReason::kNone;
+}
+
+// Pure set filtering and the weighted pick, reads nothing but the snapshot.
+FailReason Kaputt::filterSubmit(SubmitSnapshot& snapshot, uint32_t& anim_idx)
+{
+    auto& index    = *snapshot.index;
+    auto& exp_bits = index.exp_bits;
 
-        playPairedIdle(idle, attacker, victim);
+    auto anims = index.getCovered(snapshot.att_skel, snapshot.vic_skel);
+    std::erase_if(anims, [&](auto idx) {
+        return !exp_bits[idx].containsAll(snapshot.req_mask) || exp_bits[idx].intersects(snapshot.ban_mask) ||
+            !snapshot.param_query->eval(exp_bits[idx]) || !snapshot.info_query->eval(exp_bits[idx]);
+    });
+    if (anims.empty())
+        return FailReason::kNoAnimation;
 
+    // filtered on its own, an IdleTagger result only holds for the moment
+    std::erase_if(anims, [&](auto idx) {
+        return !exp_bits[idx].containsAll(snapshot.tagger_req_mask) || exp_bits[idx].intersects(snapshot.tagger_ban_mask);
+    });
 
-        return true;
+    logger::debug("Filter over, {} of {} left", anims.size(), index.size());
+    if (anims.empty())
+        return FailReason::kNoTaggedAnimation;
+
+    anim_idx = pickAnim(index, anims, snapshot.set_key, std::span{snapshot.recent_ids}.first(snapshot.recent_count), snapshot.rng);
+    if (!index.idles[anim_idx])
+    {
+        logger::warn("Registered animation {} has no corresponding IdleForm. Please report to the author.", index.getEdid(anim_idx));
+        return FailReason::kOther;
     }
-    else
+    return FailReason::kNone;
+}
+
+FailReason Kaputt::commitSubmit(const SubmitSnapshot& snapshot, uint32_t anim_idx)
+{
+    auto attacker = snapshot.attacker.get();
+    auto victim   = snapshot.victim.get();
+    if (!attacker || !victim)
+        return FailReason::kNotPlayable;
+
+    // preprocess
+    attacker->NotifyAnimationGraph("attackStop");
+    victim->NotifyAnimationGraph("attackStop");
+    attacker->NotifyAnimationGraph("staggerStop");
+    victim->NotifyAnimationGraph("staggerStop");
+    if ((victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kGetUp) ||
+        (victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kQueued))
     {
-        logger::warn("Registered animation {} has no corresponding IdleForm. Please report to the author.", edid);
-        return false;
+        victim->AsActorState()->actorState1.knockState = RE::KNOCK_STATE_ENUM::kNormal;
+        victim->NotifyAnimationGraph("GetUpEnd");
     }
+
+    auto idle = snapshot.index->idles[anim_idx];
+    playPairedIdle(idle, attacker.get(), victim.get());
+    PlayHistory::getSingleton()->record(attacker.get(), idle->GetFormID());
+
+    return FailReason::kNone;
 }
 
 } // namespace kaputt
\ No newline at end of file
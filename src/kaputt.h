@@ -1,9 +1,16 @@
 #pragma once
 
 #include "kaputtAPI.h"
+#include "utils.h"
+#include "search.h"
+#include "query.h"
+#include "sampling.h"
+#include "submit.h"
 
 #include <nlohmann/json.hpp>
 
+#include <filesystem>
+
 namespace kaputt
 {
 
@@ -13,8 +20,11 @@ struct MiscParams
     bool disable_vanilla_sneak  = true;
     bool disable_vanilla_dragon = true;
     bool enable_debug_log       = false;
+    bool hot_reload             = false;
+    bool deterministic          = false; // see RandomStreams
+    bool validate_conditions    = false; // see ConditionEvaluator
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(MiscParams, disable_vanilla, disable_vanilla_sneak, disable_vanilla_dragon, enable_debug_log)
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(MiscParams, disable_vanilla, disable_vanilla_sneak, disable_vanilla_dragon, enable_debug_log, hot_reload, deterministic, validate_conditions)
 
 struct PreconditionParams
 {
@@ -31,12 +41,15 @@ struct PreconditionParams
     bool                 furn_lean                         = false;
     bool                 furn_sleep                        = false;
     std::array<float, 2> height_diff_range                 = {-35.f, 35.f};
+    float                fail_cooldown                     = 0.5f; // seconds a failed attacker/victim pair is skipped, see FailureCache
     StrSet               skipped_race                      = {"FrostbiteSpiderRaceGiant",
                                                               "SprigganMatronRace",
                                                               "SprigganEarthMotherRace",
                                                               "DLC2SprigganBurntRace",
                                                               "DLC1LD_ForgemasterRace",
                                                               "DLC2GhostFrostGiantRace"};
+
+    bool operator==(const PreconditionParams&) const = default;
 };
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
     PreconditionParams,
@@ -48,6 +61,7 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
     furn_lean,
     furn_sleep,
     height_diff_range,
+    fail_cooldown,
     skipped_race)
 
 struct RequiredRefs
@@ -74,14 +88,39 @@ struct TaggingParams
     bool   decap_bleed_ignore_perk = true;
     bool   decap_use_chance        = false;
     float  decap_percent           = 30.f;
+
+    std::string tag_query = ""; // see query.h
+
+    // how many of the latest picks to avoid repeating, see PlayHistory
+    int avoid_recent          = 2;
+    int avoid_recent_attacker = 4;
+
+    bool operator==(const TaggingParams&) const = default;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(TaggingParams, required_tags, banned_tags, decap_disable_player, decap_requires_perk, decap_bleed_ignore_perk, decap_use_chance, decap_percent, tag_query, avoid_recent, avoid_recent_attacker);
+
+// Why a precondition or submit failed
+enum class FailReason : uint8_t
+{
+    kNone,
+    kNotPlayable,
+    kEssential,
+    kProtected,
+    kFurniture,
+    kHeight,
+    kHostileInRange,
+    kRace,
+    kNoAnimation,       // for the skeletons, tags and queries
+    kNoTaggedAnimation, // left out by the IdleTagger, which depends on the moment
+    kOther
 };
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(TaggingParams, required_tags, banned_tags, decap_disable_player, decap_requires_perk, decap_bleed_ignore_perk, decap_use_chance, decap_percent);
 
 class Kaputt : public KaputtAPI
 {
     friend void drawSettingMenu();
     friend void drawTriggerMenu();
     friend void drawAnimationMenu();
+    friend class HotReload;
 
 private:
     std::atomic_bool ready;
@@ -115,9 +154,31 @@ private:
      *  sneak: sneaking killmove
      *  bleed: bleedout execution
      *  a_/v_player: player only
+     *
+     *  The packs' anims are registered in anim_index, only the edits saved to the config are kept by edid.
+     *  Those and tagexp_list are game thread only, the menu queues its edits through the TaskManager.
      */
-    StrMap<StrSet> anim_tags_map        = {};
     StrMap<StrSet> anim_custom_tags_map = {};
+    StrMap<float>  anim_custom_weights  = {}; // selection weights, 1 if not set, 0 disables the anim
+    StrMap<StrSet> anim_pack_shadows    = {}; // pack file name -> edids it defines that another pack registered
+
+    std::atomic_uint64_t tags_generation = 0; // bumped whenever anims or their tags change, for derived caches
+
+    // settings the cached failures were found under, see pollSettingsChange
+    PreconditionParams seen_precond_params = {};
+    TaggingParams      seen_tagging_params = {};
+    uint64_t           seen_tags_gen       = 0;
+
+    TrigramIndex                     edid_index      = {}; // for searching by ID in the menu, rebuilt lazily after packs change
+    std::shared_ptr<const AnimIndex> edid_index_keys = {}; // the index whose edid pool it points into
+
+    // the registry, rebuilt and published on the game thread, read from any
+    mutable std::mutex                           index_lock  = {}; // guards anim_index and query_cache
+    std::shared_ptr<const AnimIndex>             anim_index  = std::make_shared<const AnimIndex>();
+    StrMap<std::shared_ptr<const CompiledQuery>> query_cache = {}; // compiled against the current anim_index
+    WeightedSampler                              sampler     = {}; // alias tables over anim_index
+    uint64_t                                     sampler_gen = 0;  // generation of the index the tables are over
+    std::mutex                                   sampler_lock;     // picks run on the submit worker too
 
     PreconditionParams precond_params = {};
     TaggingParams      tagging_params = {};
@@ -125,11 +186,27 @@ private:
 
     RequiredRefs required_refs = {};
 
+    struct PackRead
+    {
+        std::string           name          = {};
+        std::vector<PackAnim> anims         = {};
+        bool                  missing_forms = false;
+    };
+
     bool        loadRefs();
+    static bool readAnimPack(const std::filesystem::path& file_path, TagTable& tags, PackRead& pack); // false if the file is broken
+    StrSet      registerPacks(std::vector<PackRead> packs, TagTable tags);                             // returns the edids they held before and no longer do
+    void        restoreShadowed(const StrSet& edids);
+    void        buildEdidIndex(std::shared_ptr<const AnimIndex> index);
+    void        publishAnimIndex(std::shared_ptr<const AnimIndex> index);
+    void        applyOverrides(AnimIndex& index) const;
+    uint32_t    pickAnim(const AnimIndex& index, std::vector<uint32_t>& anims, uint64_t set_key, std::span<const RE::FormID> recent_ids, Rng& rng);
     inline void clear()
     {
+        ++tags_generation;
         misc_params          = {};
         anim_custom_tags_map = {};
+        anim_custom_weights  = {};
         precond_params       = {};
         tagging_params       = {};
         tagexp_list          = {};
@@ -143,28 +220,63 @@ public:
         return std::addressof(kaputt);
     }
     bool                        init();
-    virtual inline REL::Version getVersion() { return {1, 0, 0, 0}; }
+    virtual inline REL::Version getVersion() { return API_VER; }
     virtual inline bool         isReady() { return ready.load(); }
 
     // FILE IO
     bool loadAnims();
+    bool loadAnimPack(const std::filesystem::path& file_path); // replaces what the pack had registered, keeps it ahead of other packs
+    void unloadAnimPack(std::string_view pack);
 
     NLOHMANN_DEFINE_TYPE_INTRUSIVE(Kaputt, anim_custom_tags_map, misc_params, precond_params, tagging_params, tagexp_list)
     bool loadConfig(std::string_view dir);
-    bool saveConfig(std::string_view dir);
+    bool applyConfig(const json& j); // game thread only
+    bool saveConfig(std::string_view dir); // queues the write, result is reported through the status message
 
     // ANIM
-    std::vector<std::string_view> listAnims(std::string_view filter_str = "", int filter_mode = 0);
-    const StrSet&                 getTags(std::string_view edid); // please make sure the tag is in the map
-    bool                          setTags(std::string_view edid, const StrSet& tags);
+    // menu only, indices into the given index
+    std::vector<uint32_t> listAnims(const std::shared_ptr<const AnimIndex>& index, std::string_view filter_str = "", int filter_mode = 0);
+
+    // game thread, published by the next updateAnimIndex
+    bool setTags(std::string_view edid, const StrSet& tags);
+    void resetTags(std::string_view edid);
+    bool setWeight(std::string_view edid, float weight);
+    void resetWeight(std::string_view edid);
+    void setTagExpansions(StrMap<StrSet> expansions);
+
+    void                                 resetSampler() // its state picks between sampling paths, reset for replays
+    {
+        std::scoped_lock l(sampler_lock);
+        sampler.clear();
+    }
+    std::shared_ptr<const AnimIndex>     getAnimIndex() const; // the published one, any thread
+    void                                 updateAnimIndex();    // game thread, once a frame
+    bool                                 isCovered(const RE::Actor* attacker, const RE::Actor* victim); // any anim for their skeletons
+    std::shared_ptr<const CompiledQuery> compileQuery(const AnimIndex& index, std::string_view query_str); // nullptr if malformed
 
     //
     void applyRefs();
 
+    float      getFailCooldown() const { return precond_params.fail_cooldown; }
+    bool       pollSettingsChange(); // true once after settings that decide failures were edited
+    FailReason checkPrecondition(const RE::Actor* attacker, const RE::Actor* victim);
+    FailReason trySubmit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info = {}, std::string_view tag_query = ""); // all phases in place
+
+    // submit phases
+    FailReason snapshotSubmit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, std::string_view tag_query, SubmitSnapshot& snapshot); // game thread
+    FailReason filterSubmit(SubmitSnapshot& snapshot, uint32_t& anim_idx);                                                              // any thread
+    FailReason commitSubmit(const SubmitSnapshot& snapshot, uint32_t anim_idx);                                                         // game thread
+    // snapshot now and return its failure, the rest runs on the SubmitWorker and on_done gets the outcome on a later tick
+    FailReason submitDeferred(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, SubmitWorker::Callback on_done);
+
     // API
     virtual bool precondition(const RE::Actor* attacker, const RE::Actor* victim);
     virtual bool submit(RE::Actor*              attacker,
                         RE::Actor*              victim,
                         const SubmitInfoStruct& submit_info = {});
+    virtual bool submitQuery(RE::Actor*              attacker,
+                             RE::Actor*              victim,
+                             const SubmitInfoStruct& submit_info,
+                             std::string_view        tag_query);
 };
 } // namespace kaputt
\ No newline at end of file
@@ -7,7 +7,7 @@
 
 namespace kaputt
 {
-constexpr REL::Version API_VER = {1, 0, 0, 0};
+constexpr REL::Version API_VER = {1, 1, 0, 0}; // minor versions only append to KaputtAPI
 
 struct SubmitInfoStruct
 {
@@ -24,8 +24,15 @@ public:
     virtual bool         submit(RE::Actor*              attacker,
                                 RE::Actor*              victim,
                                 const SubmitInfoStruct& submit_info = {})                 = 0; // request playing one of the registered animations with extra tag requirements.
+
+    // 1.1
+    virtual bool submitQuery(RE::Actor*              attacker,
+                             RE::Actor*              victim,
+                             const SubmitInfoStruct& submit_info,
+                             std::string_view        tag_query) = 0; // same as submit, the anim must also match the query e.g. "a_sword_r & (front | back) & !decap", wildcards like a_*_l allowed
 };
 
+// GetKaputtInterface hands out the 1.0 interface to consumers built against it, GetKaputtInterface2 the current one.
 [[nodiscard]] inline std::variant<KaputtAPI*, std::string> RequestKaputtAPI()
 {
     typedef KaputtAPI* (*_RequestKaputtAPIFunc)();
@@ -34,15 +41,17 @@ public:
     if (!pluginHandle)
         return "Cannot find Kaputt.";
 
-    _RequestKaputtAPIFunc requestAPIFunc = (_RequestKaputtAPIFunc)GetProcAddress(pluginHandle, "GetKaputtInterface");
+    _RequestKaputtAPIFunc requestAPIFunc = (_RequestKaputtAPIFunc)GetProcAddress(pluginHandle, "GetKaputtInterface2");
     if (requestAPIFunc)
     {
         auto api = requestAPIFunc();
-        if (api->getVersion() == API_VER)
+        if ((api->getVersion().major() == API_VER.major()) && (api->getVersion() >= API_VER))
             return api;
         else
             return std::format("Version mismatch! Requested {}. Get {}.", API_VER, api->getVersion());
     }
+    else if (GetProcAddress(pluginHandle, "GetKaputtInterface"))
+        return std::format("Version mismatch! Requested {}. Get 1.0.", API_VER);
 
     return "Failed to get function GetKaputtInterface.";
 }
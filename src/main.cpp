@@ -7,6 +7,11 @@
 #include "tasks.h"
 #include "PrecisionAPI.h"
 #include "trigger.h"
+#include "history.h"
+#include "random.h"
+#include "failcache.h"
+#include "conditions.h"
+#include "paired.h"
 
 #define DLLEXPORT __declspec(dllexport)
 
@@ -96,6 +101,41 @@ void integrateCatMenu()
         logger::warn("CatMenu integration failed! In-game config disabled. Error: {}", std::get<1>(result));
 }
 
+void onGameSave(SKSE::SerializationInterface* intfc)
+{
+    PlayHistory::getSingleton()->save(intfc);
+    RandomStreams::getSingleton()->save(intfc);
+}
+
+void onGameLoad(SKSE::SerializationInterface* intfc)
+{
+    uint32_t type, version, length;
+    while (intfc->GetNextRecordInfo(type, version, length))
+        switch (type)
+        {
+            case PlayHistory::record_type:
+                PlayHistory::getSingleton()->load(intfc, version);
+                break;
+            case RandomStreams::record_type:
+                RandomStreams::getSingleton()->load(intfc, version);
+                break;
+            default:
+                logger::warn("Unknown record {:08X} in the co-save.", type);
+                break;
+        }
+}
+
+void onGameRevert(SKSE::SerializationInterface*)
+{
+    PlayHistory::getSingleton()->clear();
+    RandomStreams::getSingleton()->revert();
+    Kaputt::getSingleton()->resetSampler();
+    FailureCache::getSingleton()->clear();
+    TaggerCache::getSingleton()->clear();
+    WeaponCache::getSingleton()->clear();
+    PairedTracker::getSingleton()->clear();
+}
+
 void processMessage(SKSE::MessagingInterface::Message* a_msg)
 {
     switch (a_msg->type)
@@ -114,10 +154,12 @@ void processMessage(SKSE::MessagingInterface::Message* a_msg)
                 logger::info("Installing hook...");
                 stl::write_thunk_call<ProcessHitHook>();
                 stl::write_thunk_call<AttackActionHook>();
-                // stl::write_thunk_call<UpdateHook>();
+                stl::write_thunk_call<UpdateHook>();
 
                 logger::info("Registering event sinks...");
                 InputEventSink::RegisterSink();
+                EquipEventSink::RegisterSink();
+                ObjectLoadedEventSink::RegisterSink();
             }
 
             break;
@@ -136,8 +178,33 @@ void processMessage(SKSE::MessagingInterface::Message* a_msg)
             break;
     }
 }
+
+// What consumers built against API 1.0 get, they expect exactly that version. Their vtable is a prefix of the current one.
+class KaputtAPIv1 : public KaputtAPI
+{
+public:
+    REL::Version getVersion() override { return {1, 0, 0, 0}; }
+    bool         isReady() override { return Kaputt::getSingleton()->isReady(); }
+    bool         precondition(const RE::Actor* attacker, const RE::Actor* victim) override { return Kaputt::getSingleton()->precondition(attacker, victim); }
+    bool         submit(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info) override { return Kaputt::getSingleton()->submit(attacker, victim, submit_info); }
+    bool         submitQuery(RE::Actor* attacker, RE::Actor* victim, const SubmitInfoStruct& submit_info, std::string_view tag_query) override
+    {
+        return Kaputt::getSingleton()->submitQuery(attacker, victim, submit_info, tag_query);
+    }
+};
 } // namespace kaputt
 
+extern "C" DLLEXPORT kaputt::KaputtAPI* GetKaputtInterface()
+{
+    static kaputt::KaputtAPIv1 api_v1;
+    return std::addressof(api_v1);
+}
+
+extern "C" DLLEXPORT kaputt::KaputtAPI* GetKaputtInterface2()
+{
+    return kaputt::Kaputt::getSingleton();
+}
+
 SKSEPluginLoad(const SKSE::LoadInterface* a_skse)
 {
 
@@ -155,6 +222,12 @@ SKSEPluginLoad(const SKSE::LoadInterface* a_skse)
     if (!messaging->RegisterListener("SKSE", processMessage))
         return false;
 
+    auto serialization = SKSE::GetSerializationInterface();
+    serialization->SetUniqueID('KPUT');
+    serialization->SetSaveCallback(onGameSave);
+    serialization->SetLoadCallback(onGameLoad);
+    serialization->SetRevertCallback(onGameRevert);
+
     logger::info("{} loaded.", plugin->GetName());
 
     return true;
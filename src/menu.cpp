@@ -4,9 +4,15 @@
 #include "utils.h"
 #include "kaputt.h"
 #include "trigger.h"
-
-#include <filesystem>
-namespace fs = std::filesystem;
+#include "hotreload.h"
+#include "presets.h"
+#include "history.h"
+#include "random.h"
+#include "probability.h"
+#include "failcache.h"
+#include "conditions.h"
+#include "paired.h"
+#include "tasks.h"
 
 #include <imgui.h>
 #include <imgui_stdlib.h>
@@ -67,6 +73,46 @@ void drawSettingMenu()
                 spdlog::flush_on(level);
             }
 
+            ImGui::TableNextColumn();
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("Hot Reload");
+            ImGui::SameLine();
+            ImGui::TextDisabled("[?]");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Watch animation packs and kaputt.json, and reload them when they change on disk.\n"
+                                  "Meant for authoring animation packs. Unsaved changes here are lost when kaputt.json is reloaded.");
+            ImGui::TableNextColumn();
+            if (ImGui::Checkbox(misc_params.hot_reload ? "enabled##hotreload" : "disabled##hotreload", &misc_params.hot_reload) && misc_params.hot_reload)
+                HotReload::getSingleton()->snapshot();
+
+            ImGui::TableNextColumn();
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("Deterministic");
+            ImGui::SameLine();
+            ImGui::TextDisabled("[?]");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Seed the lottery, animation selection and decap chance from the save.\n"
+                                  "Loading the same save and repeating the same actions gives the same killmoves. For bug reports.");
+            ImGui::TableNextColumn();
+            if (ImGui::Checkbox(misc_params.deterministic ? "enabled##deterministic" : "disabled##deterministic", &misc_params.deterministic))
+                RandomStreams::getSingleton()->setDeterministic(misc_params.deterministic);
+            if (misc_params.deterministic)
+            {
+                ImGui::SameLine();
+                ImGui::TextDisabled("seed %016llX", RandomStreams::getSingleton()->getSeed());
+            }
+
+            ImGui::TableNextColumn();
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("Validate Conditions");
+            ImGui::SameLine();
+            ImGui::TextDisabled("[?]");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Check kaputt's own evaluation of common tagger conditions against the game's, and log any difference.\n"
+                                  "Slower, for debugging. The game's result is used when they differ.");
+            ImGui::TableNextColumn();
+            ImGui::Checkbox(misc_params.validate_conditions ? "enabled##validatecond" : "disabled##validatecond", &misc_params.validate_conditions);
+
             ImGui::EndTable();
         }
 
@@ -168,6 +214,17 @@ void drawSettingMenu()
             ImGui::SetNextItemWidth(-FLT_MIN);
             ImGui::InputFloat2("##height", precond_params.height_diff_range.data(), "%.1f");
 
+            ImGui::TableNextColumn();
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("Failure Cooldown");
+            ImGui::SameLine();
+            ImGui::TextDisabled("[?]");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Seconds an attacker and victim pair that failed the checks is skipped by the triggers. 0 to disable.");
+            ImGui::TableNextColumn();
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            ImGui::SliderFloat("##failcooldown", &precond_params.fail_cooldown, 0.f, 5.f, "%.1f s");
+
             ImGui::TableNextColumn();
             ImGui::AlignTextToFramePadding();
             ImGui::Text("Excluded Races");
@@ -206,6 +263,20 @@ void drawSettingMenu()
             ImGui::SetNextItemWidth(-FLT_MIN);
             drawTagsInputText("##bantag", tagging_params.banned_tags);
 
+            ImGui::TableNextColumn();
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("+Tag Query");
+            ImGui::SameLine();
+            ImGui::TextDisabled("[?]");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Boolean filter on top of the tags above, e.g. a_sword_r & (front | back) & !decap\n"
+                                  "Operators: ! & | ( ). Tags next to each other are AND-ed. * matches any part of a tag, e.g. a_*_l");
+            ImGui::TableNextColumn();
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            ImGui::InputText("##tagquery", &tagging_params.tag_query);
+            if (auto result = TagQuery::parse(tagging_params.tag_query); result.index() == 1)
+                ImGui::TextColored({1.f, 0.3f, 0.3f, 1.f}, "%s", std::get<1>(result).c_str());
+
             ImGui::TableNextColumn();
             ImGui::AlignTextToFramePadding();
             ImGui::Text("Player Decap");
@@ -277,6 +348,31 @@ void drawSettingMenu()
             if (!tagging_params.decap_use_chance)
                 ImGui::EndDisabled();
 
+            ImGui::EndTable();
+        }
+        if (ImGui::BeginTable("tagger3", 3))
+        {
+            ImGui::TableSetupColumn("1", 0, 1);
+            ImGui::TableSetupColumn("2", 0, 1.5);
+            ImGui::TableSetupColumn("3", 0, 1.5);
+
+            ImGui::TableNextColumn();
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("Avoid Repeats");
+            ImGui::SameLine();
+            ImGui::TextDisabled("[?]");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Animations among the last N picks are avoided if there are other choices.\n"
+                                  "Overall and per attacker. 0 to disable.");
+
+            ImGui::TableNextColumn();
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            ImGui::SliderInt("##avoidrecent", &tagging_params.avoid_recent, 0, static_cast<int>(PlayHistory::capacity), "overall %d");
+
+            ImGui::TableNextColumn();
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            ImGui::SliderInt("##avoidrecentattacker", &tagging_params.avoid_recent_attacker, 0, static_cast<int>(PlayHistory::capacity), "per attacker %d");
+
             ImGui::EndTable();
         }
     }
@@ -339,7 +435,8 @@ void drawTriggerMenu()
             {
                 ImGui::TableNextColumn();
                 ImGui::SetNextItemWidth(-FLT_MIN);
-                ImGui::SliderFloat(std::format("##km{}", i).c_str(), &vanilla_trigger->prob_km[i], 0.f, 100.f, "%.0f %%");
+                if (ImGui::SliderFloat(std::format("##km{}", i).c_str(), &vanilla_trigger->prob_km[i], 0.f, 100.f, "%.0f %%"))
+                    ProbabilityModel::getSingleton()->markDirty();
             }
 
             ImGui::TableNextColumn();
@@ -349,7 +446,8 @@ void drawTriggerMenu()
             {
                 ImGui::TableNextColumn();
                 ImGui::SetNextItemWidth(-FLT_MIN);
-                ImGui::SliderFloat(std::format("##exec{}", i).c_str(), &vanilla_trigger->prob_exec[i], 0.f, 100.f, "%.0f %%");
+                if (ImGui::SliderFloat(std::format("##exec{}", i).c_str(), &vanilla_trigger->prob_exec[i], 0.f, 100.f, "%.0f %%"))
+                    ProbabilityModel::getSingleton()->markDirty();
             }
 
             ImGui::EndTable();
@@ -424,7 +522,8 @@ void drawTriggerMenu()
             {
                 ImGui::TableNextColumn();
                 ImGui::SetNextItemWidth(-FLT_MIN);
-                ImGui::SliderFloat(std::format("##km{}", i).c_str(), &post_trigger->prob_km[i], 0.f, 100.f, "%.0f %%");
+                if (ImGui::SliderFloat(std::format("##km{}", i).c_str(), &post_trigger->prob_km[i], 0.f, 100.f, "%.0f %%"))
+                    ProbabilityModel::getSingleton()->markDirty();
             }
 
             ImGui::TableNextColumn();
@@ -434,7 +533,8 @@ void drawTriggerMenu()
             {
                 ImGui::TableNextColumn();
                 ImGui::SetNextItemWidth(-FLT_MIN);
-                ImGui::SliderFloat(std::format("##exec{}", i).c_str(), &post_trigger->prob_exec[i], 0.f, 100.f, "%.0f %%");
+                if (ImGui::SliderFloat(std::format("##exec{}", i).c_str(), &post_trigger->prob_exec[i], 0.f, 100.f, "%.0f %%"))
+                    ProbabilityModel::getSingleton()->markDirty();
             }
 
             ImGui::EndTable();
@@ -495,15 +595,118 @@ void drawTriggerMenu()
         ImGui::PopID();
         ImGui::Unindent();
     }
+
+    if (ImGui::CollapsingHeader("Statistics"))
+    {
+        using Trigger = TriggerPipeline::Trigger;
+        using Stage   = TriggerPipeline::Stage;
+
+        auto pipeline = TriggerPipeline::getSingleton();
+        if (ImGui::BeginTable("stats", 7, ImGuiTableFlags_Borders))
+        {
+            for (auto header : {"", "Triggered", "Classified", "Lottery", "Covered", "Precondition", "Played"})
+                ImGui::TableSetupColumn(header);
+            ImGui::TableHeadersRow();
+
+            constexpr std::array<std::pair<Trigger, const char*>, 3> rows = {{{Trigger::kVanilla, "Vanilla-ish"}, {Trigger::kPostHit, "Post-Hit"}, {Trigger::kSneak, "Sneak"}}};
+            for (auto [trigger, name] : rows)
+            {
+                ImGui::TableNextColumn();
+                ImGui::Text(name);
+                for (auto stage : {Stage::kGate, Stage::kClassify, Stage::kLottery, Stage::kCoverage, Stage::kPrecondition, Stage::kSubmit})
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", pipeline->getCount(trigger, stage));
+                }
+            }
+
+            ImGui::EndTable();
+        }
+        ImGui::Text("Post-Hit evaluations skipped for hits on the same victim in a frame: %llu", PostHitTrigger::getSingleton()->getCoalescedCount());
+
+        auto fail_cache = FailureCache::getSingleton();
+        ImGui::Text("Checks skipped for recently failed pairs: %llu", fail_cache->getAvoidedCount());
+        ImGui::Text("Of the rechecked skipped pairs, still failing: %llu, went through: %llu", fail_cache->getVerifiedCount(), fail_cache->getFalseNegativeCount());
+
+        ImGui::Text("Tagger conditions evaluated natively: %llu, by the game: %llu, mismatches found by validation: %llu",
+                    ConditionEvaluator::getNativeCount(), ConditionEvaluator::getFallbackCount(), ConditionEvaluator::getMismatchCount());
+        ImGui::Text("Tagger items reused from the same actor's earlier results: %llu", TaggerCache::getSingleton()->getHitCount());
+        auto paired = PairedTracker::getSingleton();
+        ImGui::Text("Paired animation checks: %llu, answered by the game's condition: %llu, of which disagreed with the tracked events: %llu",
+                    paired->getCheckCount(), paired->getPollCount(), paired->getCorrectionCount());
+
+        auto   index     = Kaputt::getSingleton()->getAnimIndex();
+        size_t idx_bytes = index->memoryUsage();
+        size_t map_bytes = index->override_memory;
+        ImGui::Text("Animation registry: %zu KB total, %zu KB for the index plus %zu KB of custom overrides",
+                    (idx_bytes + map_bytes) / 1024, idx_bytes / 1024, map_bytes / 1024);
+    }
 }
 
+// Rows shown in the animation menu. Rebuilt only when the filter changes or a new index is published.
+struct AnimBrowser
+{
+    struct Row
+    {
+        std::string_view edid;
+        RE::TESIdleForm* idle;
+        std::string      tags_str;
+        bool             custom;
+        float            weight;
+        bool             custom_weight;
+    };
+
+    std::shared_ptr<const AnimIndex> index        = {}; // the rows point into it
+    std::vector<Row>                 rows         = {}; // every registered anim, by anim index
+    std::vector<uint32_t>            filtered     = {}; // indices into rows
+    std::string                      filter_text  = {};
+    int                              filter_mode  = -1;
+    bool                             filter_dirty = true;
+
+    void update(Kaputt* kaputt, std::string_view new_filter_text, int new_filter_mode)
+    {
+        if (auto latest = kaputt->getAnimIndex(); latest != index)
+        {
+            index = std::move(latest);
+            rows.clear();
+            for (uint32_t anim_idx = 0; anim_idx < index->size(); ++anim_idx)
+                rows.push_back({index->getEdid(anim_idx), index->idles[anim_idx], joinTags(index->getTags(anim_idx)), index->custom_tags[anim_idx],
+                                index->weights[anim_idx], index->custom_weights[anim_idx]});
+            filter_dirty = true;
+        }
+
+        if ((new_filter_text != filter_text) || (new_filter_mode != filter_mode))
+        {
+            filter_text  = new_filter_text;
+            filter_mode  = new_filter_mode;
+            filter_dirty = true;
+        }
+
+        if (!filter_dirty)
+            return;
+        filter_dirty = false;
+
+        filtered = kaputt->listAnims(index, filter_text, filter_mode);
+    }
+};
+
 void drawAnimationMenu()
 {
     static std::string filter_text = {};
     static int         filter_mode = 0; // 0 None 1 ID 2 Tags
+    static AnimBrowser browser     = {};
 
-    auto  kaputt      = Kaputt::getSingleton();
-    auto& tagexp_list = kaputt->tagexp_list;
+    // edited here and handed to the game thread as a whole, replaced when a new index comes out
+    static StrMap<StrSet> tagexp_list    = {};
+    static uint64_t       tagexp_gen     = static_cast<uint64_t>(-1);
+    bool                  tagexp_changed = false;
+
+    auto kaputt = Kaputt::getSingleton();
+    if (auto index = kaputt->getAnimIndex(); index->generation != tagexp_gen)
+    {
+        tagexp_list = index->tag_expansions;
+        tagexp_gen  = index->generation;
+    }
 
     // Tag Expansions
     if (ImGui::BeginTable("tagexp config", 2))
@@ -519,8 +722,8 @@ void drawAnimationMenu()
                               "Tags will be expanded only once i.e. the tags on the right cannot be expanded furthermore.");
 
         ImGui::TableNextColumn();
-        if (ImGui::Button("Add", {-FLT_MIN, 0.f}))
-            tagexp_list.try_emplace("from", StrSet{"to"});
+        if (ImGui::Button("Add", {-FLT_MIN, 0.f}) && tagexp_list.try_emplace("from", StrSet{"to"}).second)
+            tagexp_changed = true;
 
         ImGui::EndTable();
     }
@@ -555,12 +758,14 @@ void drawAnimationMenu()
 
             ImGui::TableNextColumn();
             ImGui::SetNextItemWidth(-FLT_MIN);
-            drawTagsInputText("##to", to);
+            if (drawTagsInputText("##to", to))
+                tagexp_changed = true;
 
             ImGui::PopID();
         }
         if (!swap_from.empty() && !tagexp_list.contains(swap_to))
         {
+            tagexp_changed = true;
             if (swap_to.empty())
                 tagexp_list.erase(swap_from);
             else
@@ -573,6 +778,8 @@ void drawAnimationMenu()
 
         ImGui::EndTable();
     }
+    if (tagexp_changed)
+        TaskManager::getSingleton()->addTask(0, [expansions = tagexp_list] { Kaputt::getSingleton()->setTagExpansions(expansions); });
 
 
     // anim filters
@@ -593,7 +800,8 @@ void drawAnimationMenu()
         ImGui::TableNextColumn();
         ImGui::RadioButton("Tag", &filter_mode, 2);
         if (ImGui::IsItemHovered())
-            ImGui::SetTooltip("Separate each tag with SPACE.");
+            ImGui::SetTooltip("Separate each tag with SPACE.\n"
+                              "Also takes a tag query, e.g. a_*_r & (front | back) & !decap");
 
         ImGui::EndTable();
     }
@@ -601,31 +809,33 @@ void drawAnimationMenu()
     // list of anims
     constexpr auto table_flags =
         ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY;
-    if (ImGui::BeginTable("Animation Entries", 2, table_flags, {0.f, -FLT_MIN}))
+    if (ImGui::BeginTable("Animation Entries", 3, table_flags, {0.f, -FLT_MIN}))
     {
         ImGui::TableSetupColumn("Editor ID", ImGuiTableColumnFlags_WidthStretch, 0.4f);
-        ImGui::TableSetupColumn("Tags", ImGuiTableColumnFlags_WidthStretch, 0.6f);
+        ImGui::TableSetupColumn("Tags", ImGuiTableColumnFlags_WidthStretch, 0.5f);
+        ImGui::TableSetupColumn("Weight", ImGuiTableColumnFlags_WidthStretch, 0.1f);
         ImGui::TableSetupScrollFreeze(0, 1);
         ImGui::TableHeadersRow();
 
-        auto anim_list = kaputt->listAnims(filter_text, filter_mode);
+        browser.update(kaputt, filter_text, filter_mode);
 
         ImGuiListClipper clipper;
-        clipper.Begin((int)anim_list.size());
+        clipper.Begin((int)browser.filtered.size());
         while (clipper.Step())
             for (int row_n = clipper.DisplayStart; row_n < clipper.DisplayEnd; row_n++)
             {
-                auto edid = anim_list[row_n];
+                auto const& row  = browser.rows[browser.filtered[row_n]];
+                auto        edid = row.edid;
 
                 ImGui::PushID(edid.data());
 
                 ImGui::TableNextColumn();
                 ImGui::AlignTextToFramePadding();
-                if (kaputt->anim_custom_tags_map.contains(edid))
+                if (row.custom)
                     ImGui::PushStyleColor(ImGuiCol_Text, {0.5f, 0.5f, 1.f, 1.f}); // indicate custom tags
                 if (ImGui::Selectable(edid.data(), false))
-                    testPlayPairedIdle(RE::TESForm::LookupByEditorID<RE::TESIdleForm>(edid));
-                if (kaputt->anim_custom_tags_map.contains(edid))
+                    testPlayPairedIdle(row.idle);
+                if (row.custom)
                     ImGui::PopStyleColor();
                 if (ImGui::IsItemHovered())
                     ImGui::SetTooltip("Click to test it on the nearest NPC.\n"
@@ -633,14 +843,16 @@ void drawAnimationMenu()
                                       "The conditions are not checked. So be wary.");
 
                 ImGui::TableNextColumn();
-                auto tags_str = joinTags(kaputt->getTags(edid));
+                auto tags_str = row.tags_str;
                 ImGui::SetNextItemWidth(-FLT_MIN);
                 if (ImGui::InputText("##", &tags_str, ImGuiInputTextFlags_EnterReturnsTrue))
                 {
-                    if (tags_str.empty())
-                        kaputt->anim_custom_tags_map.erase(edid);
-                    else
-                        kaputt->setTags(edid, splitTags(tags_str));
+                    TaskManager::getSingleton()->addTask(0, [edid = std::string{edid}, tags = splitTags(tags_str)] {
+                        if (tags.empty())
+                            Kaputt::getSingleton()->resetTags(edid);
+                        else
+                            Kaputt::getSingleton()->setTags(edid, tags);
+                    });
                 }
 
                 if (ImGui::IsItemHovered())
@@ -649,6 +861,28 @@ void drawAnimationMenu()
                                       "Leave empty and press Enter to set to default.\n"
                                       "(Remember to save to file afterwards.)");
 
+                ImGui::TableNextColumn();
+                auto weight = row.weight;
+                ImGui::SetNextItemWidth(-FLT_MIN);
+                if (row.custom_weight)
+                    ImGui::PushStyleColor(ImGuiCol_Text, {0.5f, 0.5f, 1.f, 1.f});
+                if (ImGui::InputFloat("##weight", &weight, 0.f, 0.f, "%.2f", ImGuiInputTextFlags_EnterReturnsTrue))
+                {
+                    TaskManager::getSingleton()->addTask(0, [edid = std::string{edid}, weight] {
+                        if (weight < 0.f)
+                            Kaputt::getSingleton()->resetWeight(edid);
+                        else
+                            Kaputt::getSingleton()->setWeight(edid, weight);
+                    });
+                }
+                if (row.custom_weight)
+                    ImGui::PopStyleColor();
+
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("Relative chance of being picked among the matching animations.\n"
+                                      "0 disables it. Enter a negative number to set to default.\n"
+                                      "(Remember to save to file afterwards.)");
+
                 ImGui::PopID();
             }
 
@@ -661,6 +895,8 @@ bool drawCatMenu()
     bool show_window = true;
 
     auto kaputt = Kaputt::getSingleton();
+    if (kaputt->pollSettingsChange()) // failures found under the old settings
+        FailureCache::getSingleton()->clear();
 
     if (ImGui::Begin("Kaputt Config Menu", &show_window, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse))
     {
@@ -674,10 +910,11 @@ bool drawCatMenu()
 
             ImGui::TableNextColumn();
             ImGui::PushStyleColor(ImGuiCol_Button, {0.5f, 0.1f, 0.1f, 1.f});
-            if (ImGui::Button("Save", {-FLT_MIN, 0.f}))
-                setStatusMessage(kaputt->saveConfig(def_config_path) ?
-                                     std::format("Config saved to {}", def_config_path) :
-                                     "Something went wrong while saving. Please check the log.");
+            if (ImGui::Button("Save", {-FLT_MIN, 0.f})) // snapshot on the game thread, where the overrides are written
+                TaskManager::getSingleton()->addTask(0, [] {
+                    if (!Kaputt::getSingleton()->saveConfig(def_config_path))
+                        setStatusMessage("Something went wrong while saving. Please check the log.");
+                });
             ImGui::PopStyleColor();
 
             ImGui::TableNextColumn();
@@ -688,10 +925,10 @@ bool drawCatMenu()
                 static std::string save_name = {};
                 if (ImGui::InputText("Press Enter", &save_name, ImGuiInputTextFlags_EnterReturnsTrue, filterFilename))
                 {
-                    setStatusMessage(
-                        kaputt->saveConfig(config_dir + "\\"s + save_name + ".json") ?
-                            "Config saved as " + save_name :
-                            "Something went wrong while saving " + save_name + ". Please check the log.");
+                    TaskManager::getSingleton()->addTask(0, [name = save_name] {
+                        if (!Kaputt::getSingleton()->saveConfig(config_dir + "\\"s + name + ".json"))
+                            setStatusMessage("Something went wrong while saving " + name + ". Please check the log.");
+                    });
                     ImGui::CloseCurrentPopup();
                 }
                 ImGui::EndPopup();
@@ -699,31 +936,36 @@ bool drawCatMenu()
 
             ImGui::TableNextColumn();
             if (ImGui::Button("Load Preset", {-FLT_MIN, 0.f}))
+            {
+                PresetManager::getSingleton()->refresh();
                 ImGui::OpenPopup("load config");
+            }
             if (ImGui::BeginPopup("load config"))
             {
-                static std::string load_name  = {};
-                bool               has_preset = false;
-
-                if (fs::exists(config_dir))
-                    for (auto const& dir_entry : fs::directory_iterator{fs::path(config_dir)})
-                        if (dir_entry.is_regular_file())
-                            if (auto file_path = dir_entry.path(); file_path.extension() == ".json")
-                            {
-                                has_preset = true;
-                                if (ImGui::Selectable(file_path.stem().string().c_str()))
-                                {
-                                    setStatusMessage(
-                                        kaputt->loadConfig(file_path.string()) ?
-                                            "Loaded config preset " + load_name :
-                                            "Something went wrong while loading " + load_name + ". Please check the log.");
-                                    ImGui::CloseCurrentPopup();
-                                }
-                            }
-
-                if (!has_preset)
+                auto preset_manager = PresetManager::getSingleton();
+                auto presets        = preset_manager->getIndex();
+
+                for (auto const& preset : *presets)
+                {
+                    if (ImGui::Selectable(preset.name.c_str()))
+                    {
+                        setStatusMessage("Loading config preset " + preset.name + " ...");
+                        preset_manager->load(preset);
+                        ImGui::CloseCurrentPopup();
+                    }
+                    if (ImGui::IsItemHovered())
+                        ImGui::SetTooltip("%s\n%s | %llu bytes", preset.summary.c_str(), preset.modified.c_str(), static_cast<unsigned long long>(preset.size));
+                }
+
+                if (preset_manager->isScanning())
+                    ImGui::TextDisabled("Scanning presets...");
+                else if (presets->empty())
                     ImGui::TextDisabled("No presets found.");
 
+                ImGui::Separator();
+                if (ImGui::Selectable("Refresh", false, ImGuiSelectableFlags_NoAutoClosePopups))
+                    preset_manager->refresh(true);
+
                 ImGui::EndPopup();
             }
 
@@ -754,7 +996,10 @@ bool drawCatMenu()
         }
         ImGui::EndChild();
 
-        ImGui::TextDisabled(status_msg.c_str());
+        {
+            std::scoped_lock l(status_msg_mutex); // also written by background tasks
+            ImGui::TextDisabled(status_msg.c_str());
+        }
     }
     ImGui::End();
 
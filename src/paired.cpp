@@ -0,0 +1,70 @@
+#include "paired.h"
+
+#include "re.h"
+
+namespace kaputt
+{
+bool PairedTracker::isPaired(const RE::Actor* actor)
+{
+    auto frame = UpdateHook::frame.load(std::memory_order_relaxed);
+    auto id    = actor->GetFormID();
+    checks.fetch_add(1, std::memory_order_relaxed);
+
+    std::optional<bool> known = std::nullopt;
+    {
+        std::lock_guard guard(lock);
+        if (auto entry = entries.find(id); entry)
+        {
+            if (!entry->stale && (frame - entry->checked < recheck_frames))
+                return entry->paired;
+            if (!entry->stale)
+                known = entry->paired;
+        }
+    }
+
+    polls.fetch_add(1, std::memory_order_relaxed);
+    bool paired = isInPairedAnimation(actor);
+    if (known && (*known != paired))
+        corrections.fetch_add(1, std::memory_order_relaxed);
+
+    if (!known) // new or stale, the sink may not be on this actor's graph yet
+        PairedAnimGraphEventSink::RegisterSink(actor);
+
+    std::lock_guard guard(lock);
+    entries.getOrInsert(id) = {paired, false, frame};
+    return paired;
+}
+
+void PairedTracker::start(RE::Actor* actor)
+{
+    PairedAnimGraphEventSink::RegisterSink(actor);
+
+    std::lock_guard guard(lock);
+    entries.getOrInsert(actor->GetFormID()) = {true, false, UpdateHook::frame.load(std::memory_order_relaxed)};
+}
+
+void PairedTracker::end(RE::FormID actor)
+{
+    std::lock_guard guard(lock);
+    entries.getOrInsert(actor) = {false, false, UpdateHook::frame.load(std::memory_order_relaxed)};
+}
+
+void PairedTracker::touch(RE::FormID actor)
+{
+    std::lock_guard guard(lock);
+    if (auto entry = entries.find(actor); entry && !entry->paired)
+        entry->stale = true;
+}
+
+void PairedTracker::forget(RE::FormID actor)
+{
+    std::lock_guard guard(lock);
+    entries.erase(actor);
+}
+
+void PairedTracker::clear()
+{
+    std::lock_guard guard(lock);
+    entries.clear();
+}
+} // namespace kaputt
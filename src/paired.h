@@ -0,0 +1,48 @@
+#pragma once
+
+#include "containers.h"
+
+namespace kaputt
+{
+// Which actors are in a paired animation, so the check is a hash probe. Kaputt's own paired idles
+// are recorded when they start, and every checked actor gets PairedAnimGraphEventSink: end events
+// clear it, and other "Pair" events on an actor that isn't paired may be the engine starting one, so
+// its answer is dropped. The game's condition decides for new and dropped entries, and once an
+// answer is recheck_frames old in case an event was missed.
+class PairedTracker
+{
+public:
+    static constexpr uint64_t recheck_frames = 15;
+
+    static PairedTracker* getSingleton()
+    {
+        static PairedTracker tracker;
+        return std::addressof(tracker);
+    }
+
+    bool isPaired(const RE::Actor* actor);
+    void start(RE::Actor* actor); // a paired idle was just played on it
+    void end(RE::FormID actor);
+    void touch(RE::FormID actor); // other paired graph events
+    void forget(RE::FormID actor); // actor unloaded
+    void clear();
+
+    uint64_t getCheckCount() const { return checks.load(std::memory_order_relaxed); }
+    uint64_t getPollCount() const { return polls.load(std::memory_order_relaxed); }           // checks the condition answered
+    uint64_t getCorrectionCount() const { return corrections.load(std::memory_order_relaxed); } // polls that disagreed with the tracked state
+
+private:
+    struct Entry
+    {
+        bool     paired  = false;
+        bool     stale   = false; // a graph event came since, not trusted anymore
+        uint64_t checked = 0;     // frame of the last event or poll
+    };
+
+    std::mutex            lock        = {};
+    FormTable<Entry, 512> entries     = {};
+    std::atomic_uint64_t  checks      = 0;
+    std::atomic_uint64_t  polls       = 0;
+    std::atomic_uint64_t  corrections = 0;
+};
+} // namespace kaputt
@@ -0,0 +1,139 @@
+#include "presets.h"
+
+#include "kaputt.h"
+#include "menu.h"
+#include "tasks.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace kaputt
+{
+std::shared_ptr<const PresetManager::Index> PresetManager::getIndex()
+{
+    std::scoped_lock l(index_mutex);
+    return index;
+}
+
+void PresetManager::refresh(bool force)
+{
+    std::error_code ec;
+    auto            mtime = fs::last_write_time(config_dir, ec);
+    if (ec)
+    {
+        std::scoped_lock l(index_mutex);
+        index = std::make_shared<const Index>();
+        return;
+    }
+
+    {
+        std::scoped_lock l(index_mutex);
+        if (!force && (mtime == dir_mtime))
+            return;
+    }
+
+    if (scanning.exchange(true)) // the next refresh after it finishes still sees the change
+        return;
+
+    {
+        std::scoped_lock l(index_mutex);
+        dir_mtime = mtime;
+    }
+
+    std::thread([this] {
+        auto new_index = std::make_shared<const Index>(scan());
+        {
+            std::scoped_lock l(index_mutex);
+            index = std::move(new_index);
+        }
+        scanning.store(false);
+    }).detach();
+}
+
+PresetManager::Index PresetManager::scan()
+{
+    Index result = {};
+
+    std::error_code ec;
+    for (auto const& dir_entry : fs::directory_iterator{config_dir, ec})
+        if (dir_entry.is_regular_file(ec))
+            if (auto file_path = dir_entry.path(); file_path.extension() == ".json")
+            {
+                PresetInfo info;
+                info.name = file_path.stem().string();
+                info.path = file_path;
+                info.size = dir_entry.file_size(ec);
+                if (auto mtime = dir_entry.last_write_time(ec); !ec)
+                    info.modified = std::format("{:%Y-%m-%d %H:%M}", std::chrono::floor<std::chrono::minutes>(std::chrono::clock_cast<std::chrono::system_clock>(mtime)));
+                info.summary = summarize(file_path);
+                result.push_back(std::move(info));
+            }
+
+    std::ranges::sort(result, {}, &PresetInfo::name);
+    return result;
+}
+
+std::string PresetManager::summarize(const fs::path& path)
+{
+    std::ifstream istream{path};
+    if (!istream.is_open())
+        return "unreadable";
+
+    json j = json::parse(istream, nullptr, false);
+    if (j.is_discarded() || !j.is_object())
+        return "invalid json";
+
+    try
+    {
+        std::string triggers = {};
+        for (auto [key, name] : {std::pair{"vanilla", "vanilla"}, std::pair{"post_hit", "post-hit"}, std::pair{"sneak", "sneak"}})
+            if (j.value(json::json_pointer{std::format("/triggers/{}/enabled", key)}, false))
+                triggers += (triggers.empty() ? ""s : ", "s) + name;
+
+        size_t custom_tags = j.contains("anim_custom_tags_map") ? j["anim_custom_tags_map"].size() : 0;
+
+        return std::format("triggers: {} | {} custom tagged anims", triggers.empty() ? "none" : triggers, custom_tags);
+    }
+    catch (json::exception&)
+    {
+        return "invalid preset";
+    }
+}
+
+void PresetManager::load(const PresetInfo& preset)
+{
+    std::thread([preset] {
+        std::ifstream istream{preset.path};
+        if (!istream.is_open())
+        {
+            logger::warn("Failed to open {}", preset.path.filename().string());
+            setStatusMessage("Something went wrong while loading " + preset.name + ". Please check the log.");
+            return;
+        }
+
+        json j;
+        try
+        {
+            j = json::parse(istream);
+        }
+        catch (json::parse_error& e)
+        {
+            logParseError(e);
+            setStatusMessage("Something went wrong while loading " + preset.name + ". Please check the log.");
+            return;
+        }
+
+        // apply on the game thread, all at once
+        TaskManager::getSingleton()->addTask(0, [name = preset.name, j = std::move(j)] {
+            auto kaputt = Kaputt::getSingleton();
+            if (kaputt->applyConfig(j))
+            {
+                kaputt->applyRefs();
+                setStatusMessage("Loaded config preset " + name);
+            }
+            else
+                setStatusMessage("Something went wrong while loading " + name + ". Please check the log.");
+        });
+    }).detach();
+}
+} // namespace kaputt
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+
+namespace kaputt
+{
+struct PresetInfo
+{
+    std::string           name     = {};
+    std::filesystem::path path     = {};
+    std::uintmax_t        size     = 0;
+    std::string           modified = {};
+    std::string           summary  = {};
+};
+
+// Index of the presets in config_dir. Scanning and parsing run on worker threads,
+// the menu only ever reads the cached index.
+class PresetManager
+{
+public:
+    using Index = std::vector<PresetInfo>;
+
+    static PresetManager* getSingleton()
+    {
+        static PresetManager manager;
+        return std::addressof(manager);
+    }
+
+    std::shared_ptr<const Index> getIndex();
+    bool                         isScanning() const { return scanning.load(); }
+
+    void refresh(bool force = false); // rescans only if config_dir changed, unless forced
+    void load(const PresetInfo& preset);
+
+private:
+    std::mutex                      index_mutex;
+    std::shared_ptr<const Index>    index     = std::make_shared<const Index>();
+    std::filesystem::file_time_type dir_mtime = {};
+    std::atomic_bool                scanning  = false;
+
+    static Index       scan();
+    static std::string summarize(const std::filesystem::path& path);
+};
+} // namespace kaputt
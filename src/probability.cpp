@@ -0,0 +1,142 @@
+#include "probability.h"
+
+#include "re.h"
+#include "trigger.h"
+
+namespace kaputt
+{
+constexpr std::array<std::string_view, 11> weapon_names = {"fist", "sword", "dagger", "axe", "mace", "sword2h", "axe2h", "bow", "staff", "crossbow", "none"};
+
+void ProbabilityModel::compile()
+{
+    dirty = false;
+
+    // ids for the configured features, multipliers by id
+    auto assign = [](const StrMap<float>& mults, StrMap<uint8_t>& ids) {
+        ids.clear();
+        std::vector<float> by_id = {1.f};
+        for (auto const& [name, mult] : mults)
+        {
+            if (by_id.size() == unknown_id)
+            {
+                logger::warn("Too many skeletons in probability config, {} and after ignored.", name);
+                break;
+            }
+            ids.emplace(name, static_cast<uint8_t>(by_id.size()));
+            by_id.push_back(std::max(mult, 0.f));
+        }
+        return by_id;
+    };
+    auto attacker_mults = assign(params.attacker_skeleton, attacker_ids);
+    auto victim_mults   = assign(params.victim_skeleton, victim_ids);
+
+    std::vector<float> weapon_mults = {1.f};
+    weapon_ids.fill(0);
+    for (auto const& [name, mult] : params.weapon)
+        if (auto it = std::ranges::find(weapon_names, name); it != weapon_names.end())
+        {
+            weapon_ids[it - weapon_names.begin()] = static_cast<uint8_t>(weapon_mults.size());
+            weapon_mults.push_back(std::max(mult, 0.f));
+        }
+        else
+            logger::warn("Unknown weapon {} in probability config.", name);
+
+    auto levels = params.level_diff;
+    std::ranges::sort(levels);
+    levels.resize(std::min<size_t>(levels.size(), unknown_id - 1));
+    level_bounds.clear();
+    std::vector<float> level_mults = {};
+    for (auto const& [below, mult] : levels)
+    {
+        level_bounds.push_back(below);
+        level_mults.push_back(std::max(mult, 0.f));
+    }
+    level_mults.push_back(1.f); // above the last band
+
+    // skeletons are the axes that can grow large, the last configured ones go first
+    auto fixed_cells = 2 * 2 * 3 * weapon_mults.size() * level_mults.size();
+    if (attacker_mults.size() * victim_mults.size() > max_cells / fixed_cells)
+    {
+        logger::warn("Probability table of {} cells is too large, only the first skeletons are kept.",
+                     fixed_cells * attacker_mults.size() * victim_mults.size());
+
+        auto trim = [](std::vector<float>& mults, StrMap<uint8_t>& ids, size_t size) {
+            mults.resize(std::max<size_t>(size, 1));
+            std::erase_if(ids, [&](auto const& item) { return item.second >= mults.size(); });
+        };
+        auto budget = std::max<size_t>(max_cells / fixed_cells, 1);
+        auto side   = std::max<size_t>(static_cast<size_t>(std::sqrt(static_cast<double>(budget))), 1);
+        if (attacker_mults.size() <= side)
+            trim(victim_mults, victim_ids, budget / attacker_mults.size());
+        else if (victim_mults.size() <= side)
+            trim(attacker_mults, attacker_ids, budget / victim_mults.size());
+        else
+        {
+            trim(attacker_mults, attacker_ids, side);
+            trim(victim_mults, victim_ids, budget / side);
+        }
+    }
+
+    // skeleton ids to feature ids, "human" stands for skeleton_other
+    auto bySkeleton = [](const StrMap<uint8_t>& ids, std::vector<uint8_t>& skel_ids) {
+        skel_ids.assign(skeleton_other + 1, 0);
+        for (uint8_t skel = 0; skel <= skeleton_other; ++skel)
+            if (auto it = ids.find((skel == skeleton_other) ? "human"sv : skeleton_tags[skel]); it != ids.end())
+                skel_ids[skel] = it->second;
+    };
+    bySkeleton(attacker_ids, attacker_skel_ids);
+    bySkeleton(victim_ids, victim_skel_ids);
+
+    dims = {attacker_mults.size(), victim_mults.size(), weapon_mults.size(), level_mults.size()};
+
+    // [trigger][kind][pair] base chances, then the features
+    std::array<std::array<std::array<float, 3>, 2>, 2> base = {{
+        {VanillaTrigger::getSingleton()->prob_km, VanillaTrigger::getSingleton()->prob_exec},
+        {PostHitTrigger::getSingleton()->prob_km, PostHitTrigger::getSingleton()->prob_exec},
+    }};
+
+    thresholds.clear();
+    thresholds.reserve(2 * 2 * 3 * dims[0] * dims[1] * dims[2] * dims[3]);
+    for (auto const& by_trigger : base)
+        for (auto const& by_kind : by_trigger)
+            for (auto percent : by_kind)
+                for (auto attacker_mult : attacker_mults)
+                    for (auto victim_mult : victim_mults)
+                        for (auto weapon_mult : weapon_mults)
+                            for (auto level_mult : level_mults)
+                                thresholds.push_back(Rng::threshold(percent * attacker_mult * victim_mult * weapon_mult * level_mult));
+
+    logger::debug("Probability model compiled, {} cells", thresholds.size());
+}
+
+uint8_t ProbabilityModel::getWeaponId(const RE::Actor* actor) const
+{
+    constexpr size_t none = weapon_types - 1;
+
+    auto form   = actor->GetEquippedObject(false);
+    auto weapon = form ? form->As<RE::TESObjectWEAP>() : nullptr;
+    auto type   = !form ? 0 : weapon ? static_cast<size_t>(weapon->GetWeaponType()) : none; // empty is fist
+    return weapon_ids[std::min(type, none)];
+}
+
+uint8_t ProbabilityModel::getLevelId(const RE::Actor* attacker, const RE::Actor* victim) const
+{
+    int diff = static_cast<int>(attacker->GetLevel()) - static_cast<int>(victim->GetLevel());
+    return static_cast<uint8_t>(std::ranges::upper_bound(level_bounds, diff) - level_bounds.begin());
+}
+
+bool ProbabilityModel::roll(Trigger trigger, const RE::Actor* attacker, const RE::Actor* victim, bool is_exec, Rng& rng)
+{
+    if (dirty)
+        compile();
+
+    size_t pair = -1 + 2 * !attacker->IsPlayerRef() + !victim->IsPlayerRef(); // p2n, n2p, n2n
+    size_t idx  = (static_cast<size_t>(trigger) * 2 + is_exec) * 3 + pair;
+    idx         = idx * dims[0] + attacker_skel_ids[getSkeletonId(attacker)];
+    idx         = idx * dims[1] + victim_skel_ids[getSkeletonId(victim)];
+    idx         = idx * dims[2] + getWeaponId(attacker);
+    idx         = idx * dims[3] + getLevelId(attacker, victim);
+
+    return rng.chance(thresholds[idx]);
+}
+} // namespace kaputt
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "containers.h"
+#include "random.h"
+
+#include <nlohmann/json.hpp>
+
+namespace kaputt
+{
+// Multipliers on the triggers' chances, in "triggers"/"probability" of kaputt.json.
+// Features not listed here count as 1.
+struct ProbabilityParams
+{
+    StrMap<float> attacker_skeleton = {}; // by skeleton tag, "human" for humanoids, e.g. {"bear": 0.5}
+    StrMap<float> victim_skeleton   = {};
+    StrMap<float> weapon            = {}; // attacker's right hand: fist dagger sword axe mace sword2h axe2h bow staff crossbow, none for spells, torches and such
+
+    std::vector<std::pair<int, float>> level_diff = {}; // [below, multiplier] on attacker level - victim level, ascending
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(ProbabilityParams, attacker_skeleton, victim_skeleton, weapon, level_diff)
+
+// Trigger chances compiled into a dense table of thresholds, one cell per combination of
+// trigger, kind, player involvement and the configured features. A roll is a table lookup
+// and a compare against one raw draw.
+class ProbabilityModel
+{
+public:
+    enum class Trigger : uint32_t
+    {
+        kVanilla,
+        kPostHit,
+        kTotal
+    };
+
+    static ProbabilityModel* getSingleton()
+    {
+        static ProbabilityModel model;
+        return std::addressof(model);
+    }
+
+    ProbabilityParams params = {};
+
+    void markDirty() { dirty = true; } // after params or a trigger's chances changed
+    bool roll(Trigger trigger, const RE::Actor* attacker, const RE::Actor* victim, bool is_exec, Rng& rng);
+
+private:
+    static constexpr uint8_t unknown_id   = 0xFF;
+    static constexpr size_t  weapon_types = 11; // RE::WEAPON_TYPE, then anything else
+    static constexpr size_t  max_cells    = 1 << 20; // 8 MB of thresholds
+
+    bool                  dirty      = true;
+    std::vector<uint64_t> thresholds = {};
+
+    // feature ids, 0 is anything not configured
+    StrMap<uint8_t>                   attacker_ids      = {};
+    StrMap<uint8_t>                   victim_ids        = {};
+    std::vector<uint8_t>              attacker_skel_ids = {}; // by getSkeletonId
+    std::vector<uint8_t>              victim_skel_ids   = {};
+    std::array<uint8_t, weapon_types> weapon_ids        = {};
+    std::vector<int>                  level_bounds      = {}; // sorted
+    std::array<size_t, 4>             dims              = {}; // attacker, victim, weapon, level
+
+    void    compile();
+    uint8_t getWeaponId(const RE::Actor* actor) const;
+    uint8_t getLevelId(const RE::Actor* attacker, const RE::Actor* victim) const;
+};
+} // namespace kaputt
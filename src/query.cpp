@@ -0,0 +1,199 @@
+#include "query.h"
+
+namespace kaputt
+{
+bool CompiledQuery::eval(TagRow bits) const
+{
+    uint64_t stack = 0; // top of the stack is the lowest bit
+    for (auto const& [op, arg] : program)
+        switch (op)
+        {
+            case Op::kTest: stack = (stack << 1) | bits.test(arg); break;
+            case Op::kAny: stack = (stack << 1) | bits.intersects(masks[arg]); break;
+            case Op::kTrue: stack = (stack << 1) | 1; break;
+            case Op::kFalse: stack = stack << 1; break;
+            case Op::kNot: stack ^= 1; break;
+            case Op::kAnd:
+                stack = (stack >> 1) & (~1ull | (stack & 1));
+                break;
+            case Op::kOr:
+                stack = (stack >> 1) | (stack & 1);
+                break;
+        }
+    return program.empty() || (stack & 1);
+}
+
+struct TagQuery::Parser
+{
+    Parser(std::string_view str) :
+        str(str) {}
+
+    std::string_view           str;
+    size_t                     pos      = 0;
+    std::vector<Term>          program  = {};
+    int                        depth    = 0; // of the evaluation stack
+    int                        max_seen = 0;
+    int                        nesting  = 0; // of parseUnary calls, bounded to keep the native stack small
+    std::optional<std::string> error    = std::nullopt;
+
+    // expr := and_expr ('|' and_expr)*
+    void parseOr()
+    {
+        parseAnd();
+        while (!error && peek() == '|')
+        {
+            ++pos;
+            parseAnd();
+            emit({Term::Kind::kOr}, -1);
+        }
+    }
+
+    // and_expr := unary ('&'? unary)*
+    void parseAnd()
+    {
+        parseUnary();
+        while (!error)
+        {
+            auto c = peek();
+            if (c == '&')
+                ++pos;
+            else if (!c || (c == '|') || (c == ')'))
+                break;
+            parseUnary();
+            emit({Term::Kind::kAnd}, -1);
+        }
+    }
+
+    // unary := '!' unary | '(' expr ')' | tag
+    void parseUnary()
+    {
+        if (error)
+            return;
+        if (nesting >= static_cast<int>(max_depth)) // '!' and '(' recurse without growing the evaluation stack
+            return fail("query nested too deeply");
+
+        ++nesting;
+        auto c = peek();
+        if (c == '!')
+        {
+            ++pos;
+            parseUnary();
+            emit({Term::Kind::kNot}, 0);
+        }
+        else if (c == '(')
+        {
+            ++pos;
+            parseOr();
+            if (!error && peek() != ')')
+                fail("missing ')'");
+            ++pos;
+        }
+        else if (!c || isOperator(c))
+            fail(c ? std::format("unexpected '{}'", c) : "unexpected end of query");
+        else
+        {
+            auto start = pos;
+            while ((pos < str.size()) && !isspace(static_cast<unsigned char>(str[pos])) && !isOperator(str[pos]))
+                ++pos;
+            emit({Term::Kind::kTag, std::string{str.substr(start, pos - start)}}, 1);
+        }
+        --nesting;
+    }
+
+    static bool isOperator(char c) { return (c == '&') || (c == '|') || (c == '!') || (c == '(') || (c == ')'); }
+
+    char peek()
+    {
+        while ((pos < str.size()) && isspace(static_cast<unsigned char>(str[pos])))
+            ++pos;
+        return pos < str.size() ? str[pos] : '\0';
+    }
+
+    void emit(Term term, int stack_change)
+    {
+        depth += stack_change;
+        max_seen = std::max(max_seen, depth);
+        if (max_seen > static_cast<int>(max_depth))
+            fail("query nested too deeply");
+        program.push_back(std::move(term));
+    }
+
+    void fail(std::string msg)
+    {
+        if (!error)
+            error = std::format("{} at position {}", msg, pos);
+    }
+};
+
+std::variant<TagQuery, std::string> TagQuery::parse(std::string_view str)
+{
+    Parser parser{str};
+    if (parser.peek() == '\0')
+        return TagQuery{};
+
+    parser.parseOr();
+    if (!parser.error && parser.peek() != '\0')
+        parser.fail(std::format("unexpected '{}'", parser.peek()));
+    if (parser.error)
+        return *parser.error;
+
+    TagQuery query;
+    query.program = std::move(parser.program);
+    return query;
+}
+
+static bool matchWildcard(std::string_view pattern, std::string_view str)
+{
+    auto star = pattern.find('*');
+    if (star == std::string_view::npos)
+        return pattern == str;
+
+    auto head = pattern.substr(0, star);
+    if (!str.starts_with(head))
+        return false;
+    pattern.remove_prefix(star + 1);
+    str.remove_prefix(head.size());
+
+    for (size_t skip = 0; skip <= str.size(); ++skip)
+        if (matchWildcard(pattern, str.substr(skip)))
+            return true;
+    return false;
+}
+
+CompiledQuery TagQuery::compile(const TagTable& tags) const
+{
+    using Op = CompiledQuery::Op;
+
+    CompiledQuery result;
+    for (auto const& term : program)
+        switch (term.kind)
+        {
+            case Term::Kind::kTag:
+                if (!term.tag.contains('*'))
+                {
+                    auto id = tags.find(term.tag);
+                    result.program.push_back(id ? CompiledQuery::Instr{Op::kTest, *id} : CompiledQuery::Instr{Op::kFalse, 0});
+                }
+                else
+                {
+                    TagBits mask;
+                    for (uint32_t id = 0; id < tags.size(); ++id)
+                        if (matchWildcard(term.tag, tags.getName(id)))
+                            mask.set(id);
+
+                    if (mask.empty())
+                        result.program.push_back({Op::kFalse, 0});
+                    else
+                    {
+                        result.program.push_back({Op::kAny, static_cast<uint32_t>(result.masks.size())});
+                        result.masks.push_back(std::move(mask));
+                    }
+                }
+                break;
+            case Term::Kind::kNot: result.program.push_back({Op::kNot, 0}); break;
+            case Term::Kind::kAnd: result.program.push_back({Op::kAnd, 0}); break;
+            case Term::Kind::kOr: result.program.push_back({Op::kOr, 0}); break;
+        }
+    return result;
+}
+} // namespace kaputt
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "tags.h"
+
+namespace kaputt
+{
+/* Boolean tag query
+ *
+ *  a_sword_r & (front | back) & !decap
+ *  a_*_l            prefix/suffix wildcards, matches any tag that fits
+ *  sneak bleed      juxtaposition means AND, same as the old space separated tag lists
+ *
+ *  Precedence: ! > & > |
+ */
+class CompiledQuery
+{
+public:
+    bool empty() const { return program.empty(); } // an empty query matches everything
+    bool eval(TagRow bits) const;
+
+private:
+    enum class Op : uint8_t
+    {
+        kTest,
+        kAny,
+        kTrue,
+        kFalse,
+        kNot,
+        kAnd,
+        kOr
+    };
+    struct Instr
+    {
+        Op       op;
+        uint32_t arg;
+    };
+
+    std::vector<Instr>   program = {}; // postfix, evaluated on a bit stack
+    std::vector<TagBits> masks   = {}; // for wildcards
+
+    friend class TagQuery;
+};
+
+class TagQuery
+{
+public:
+    static constexpr size_t max_depth = 64;
+
+    // returns the error message if the query is malformed
+    static std::variant<TagQuery, std::string> parse(std::string_view str);
+
+    bool          empty() const { return program.empty(); }
+    CompiledQuery compile(const TagTable& tags) const;
+
+private:
+    struct Term
+    {
+        enum class Kind : uint8_t
+        {
+            kTag,
+            kNot,
+            kAnd,
+            kOr
+        } kind;
+        std::string tag = {};
+    };
+
+    std::vector<Term> program = {}; // postfix
+
+    struct Parser;
+};
+} // namespace kaputt
@@ -0,0 +1,47 @@
+#include "random.h"
+
+namespace kaputt
+{
+Rng& RandomStreams::forEvent(Stream stream)
+{
+    auto idx   = static_cast<size_t>(stream);
+    auto event = counters[idx]++;
+    if (!deterministic)
+        return threadRng();
+
+    // splitmix in seed() spreads these apart
+    streams[idx].seed(seed ^ (static_cast<uint64_t>(idx) << 56) ^ event);
+    logger::debug("Random event {} on stream {}, seed {:016X}", event, idx, seed);
+    return streams[idx];
+}
+
+void RandomStreams::save(SKSE::SerializationInterface* intfc) const
+{
+    if (!intfc->OpenRecord(record_type, record_version) || !intfc->WriteRecordData(seed) || !intfc->WriteRecordData(counters))
+        logger::warn("Failed to save random streams!");
+}
+
+void RandomStreams::load(SKSE::SerializationInterface* intfc, uint32_t version)
+{
+    revert();
+    if (version != record_version)
+    {
+        logger::warn("Unknown random streams version {}, discarded.", version);
+        return;
+    }
+
+    if (!intfc->ReadRecordData(seed) || !intfc->ReadRecordData(counters))
+    {
+        logger::warn("Random streams record is corrupted, discarded.");
+        revert();
+        return;
+    }
+    logger::info("Random seed {:016X}", seed);
+}
+
+void RandomStreams::revert()
+{
+    seed     = threadRng().next();
+    counters = {};
+}
+} // namespace kaputt
@@ -0,0 +1,120 @@
+#pragma once
+
+namespace kaputt
+{
+// xoshiro256**, 32 bytes of state. Not for anything security related.
+class Rng
+{
+public:
+    Rng() { seed(0); }
+    explicit Rng(uint64_t seed_val) { seed(seed_val); }
+
+    void seed(uint64_t seed_val)
+    {
+        for (auto& word : state) // splitmix64, so that any seed gives a well mixed state
+        {
+            seed_val += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed_val;
+            z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word       = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next()
+    {
+        uint64_t result = std::rotl(state[1] * 5, 7) * 9;
+        uint64_t t      = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = std::rotl(state[3], 45);
+        return result;
+    }
+
+    // [0, bound) without modulo bias, Lemire's multiply-shift
+    uint32_t bounded(uint32_t bound)
+    {
+        uint64_t m = (next() >> 32) * bound;
+        if (static_cast<uint32_t>(m) < bound)
+        {
+            uint32_t min_low = (0u - bound) % bound;
+            while (static_cast<uint32_t>(m) < min_low)
+                m = (next() >> 32) * bound;
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+
+    // [0, 1)
+    float uniform() { return static_cast<float>(next() >> 40) * 0x1.0p-24f; }
+
+    // percent chance as a 53 bit threshold, compute once and compare against raw draws
+    static constexpr uint64_t threshold(double percent)
+    {
+        if (!(percent > 0.0))
+            return 0;
+        if (percent >= 100.0)
+            return 1ull << 53;
+        return static_cast<uint64_t>(percent / 100.0 * static_cast<double>(1ull << 53));
+    }
+    bool chance(uint64_t threshold_val) { return (next() >> 11) < threshold_val; }
+    bool chancePercent(double percent) { return chance(threshold(percent)); }
+
+private:
+    std::array<uint64_t, 4> state = {};
+};
+
+// Stream of the calling thread, seeded from std::random_device on first use.
+// Call seed on it for a reproducible sequence.
+inline Rng& threadRng()
+{
+    thread_local Rng rng{(static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}()};
+    return rng;
+}
+
+// Streams for kaputt's random decisions, one per kind so they don't disturb each other.
+// In deterministic mode every event reseeds its stream from the save's seed and the event
+// count of that stream, so a session replays exactly from the same save.
+class RandomStreams
+{
+public:
+    enum class Stream : uint32_t
+    {
+        kLottery,
+        kSelection,
+        kDecap,
+        kTotal
+    };
+
+    static RandomStreams* getSingleton()
+    {
+        static RandomStreams streams;
+        return std::addressof(streams);
+    }
+
+    Rng& forEvent(Stream stream); // call once per event, draw from the result within that event
+
+    void     setDeterministic(bool enable) { deterministic = enable; }
+    uint64_t getSeed() const { return seed; }
+
+    // co-save
+    void save(SKSE::SerializationInterface* intfc) const;
+    void load(SKSE::SerializationInterface* intfc, uint32_t version);
+    void revert(); // new game, new seed
+
+    static constexpr uint32_t record_type    = 'RNGS';
+    static constexpr uint32_t record_version = 1;
+
+private:
+    static constexpr size_t stream_count = static_cast<size_t>(Stream::kTotal);
+
+    bool                               deterministic = false;
+    uint64_t                           seed          = 0;
+    std::array<uint64_t, stream_count> counters      = {};
+    std::array<Rng, stream_count>      streams       = {};
+
+    RandomStreams() { revert(); }
+};
+} // namespace kaputt
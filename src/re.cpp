@@ -4,6 +4,11 @@
 #include "menu.h"
 #include "trigger.h"
 #include "tasks.h"
+#include "hotreload.h"
+#include "failcache.h"
+#include "conditions.h"
+#include "containers.h"
+#include "paired.h"
 
 namespace kaputt
 {
@@ -29,7 +34,10 @@ bool AttackActionHook::thunk(RE::TESActionData* a_actionData)
 void UpdateHook::thunk(RE::Main* a_this, float a2)
 {
     func(a_this, a2);
+    UpdateHook::frame.fetch_add(1, std::memory_order_relaxed);
     TaskManager::getSingleton()->update();
+    HotReload::getSingleton()->update();
+    Kaputt::getSingleton()->updateAnimIndex(); // after the queued edits and reloads
 }
 
 EventResult InputEventSink::ProcessEvent(RE::InputEvent* const* a_event, RE::BSTEventSource<RE::InputEvent*>* a_eventSource)
@@ -82,16 +90,65 @@ EventResult PlayerAnimGraphEventSink::ProcessEvent(const RE::BSAnimationGraphEve
     return RE::BSEventNotifyControl::kContinue;
 }
 
+EventResult EquipEventSink::ProcessEvent(const RE::TESEquipEvent* a_event, RE::BSTEventSource<RE::TESEquipEvent>* a_eventSource)
+{
+    if (!a_event || !a_eventSource || !a_event->actor)
+        return RE::BSEventNotifyControl::kContinue;
+
+    // a new weapon may change the checks' outcome
+    FailureCache::getSingleton()->forget(a_event->actor->GetFormID());
+    TaggerCache::getSingleton()->forget(a_event->actor->GetFormID());
+    WeaponCache::getSingleton()->forget(a_event->actor->GetFormID());
+
+    return RE::BSEventNotifyControl::kContinue;
+}
+
+EventResult ObjectLoadedEventSink::ProcessEvent(const RE::TESObjectLoadedEvent* a_event, RE::BSTEventSource<RE::TESObjectLoadedEvent>* a_eventSource)
+{
+    if (!a_event || !a_eventSource || a_event->loaded)
+        return RE::BSEventNotifyControl::kContinue;
+    if (auto form = RE::TESForm::LookupByID(a_event->formID); !form || !form->Is(RE::FormType::ActorCharacter))
+        return RE::BSEventNotifyControl::kContinue;
+
+    // per-actor caches only hold loaded actors
+    FailureCache::getSingleton()->forget(a_event->formID);
+    TaggerCache::getSingleton()->forget(a_event->formID);
+    WeaponCache::getSingleton()->forget(a_event->formID);
+    PairedTracker::getSingleton()->forget(a_event->formID);
+
+    return RE::BSEventNotifyControl::kContinue;
+}
+
+EventResult PairedAnimGraphEventSink::ProcessEvent(const RE::BSAnimationGraphEvent* a_event, RE::BSTEventSource<RE::BSAnimationGraphEvent>* a_eventSource)
+{
+    if (!a_event || !a_eventSource || !a_event->holder)
+        return RE::BSEventNotifyControl::kContinue;
+
+    std::string_view tag = a_event->tag;
+    if ((tag == "PairEnd"sv) || (tag == "PairedStop"sv))
+        PairedTracker::getSingleton()->end(a_event->holder->GetFormID());
+    else if (tag.starts_with("Pair"sv)) // paired idles the engine or other mods start
+        PairedTracker::getSingleton()->touch(a_event->holder->GetFormID());
+
+    return RE::BSEventNotifyControl::kContinue;
+}
+
+// Built per call, nothing shared is written, so the checks below can run on any thread.
+static RE::TESConditionItem makeCondition(RE::FUNCTION_DATA::FunctionID function, RE::CONDITION_ITEM_DATA::OpCode op_code, float value,
+                                          RE::CONDITIONITEMOBJECT object = RE::CONDITIONITEMOBJECT::kSelf, ConditionParam param = {.form = nullptr})
+{
+    RE::TESConditionItem cond;
+    cond.data.functionData.function  = function;
+    cond.data.functionData.params[0] = std::bit_cast<void*>(param);
+    cond.data.flags.opCode           = op_code;
+    cond.data.comparisonValue.f      = value;
+    cond.data.object                 = object;
+    return cond;
+}
+
 bool isInPairedAnimation(const RE::Actor* actor)
 {
-    static RE::TESConditionItem cond;
-    static std::once_flag       flag;
-    std::call_once(flag, [&]() {
-        cond.data.functionData.function = RE::FUNCTION_DATA::FunctionID::kGetPairedAnimation;
-        cond.data.comparisonValue.f     = 0.0f;
-        cond.data.flags.opCode          = RE::CONDITION_ITEM_DATA::OpCode::kNotEqualTo;
-        cond.data.object                = RE::CONDITIONITEMOBJECT::kSelf;
-    });
+    auto cond = makeCondition(RE::FUNCTION_DATA::FunctionID::kGetPairedAnimation, RE::CONDITION_ITEM_DATA::OpCode::kNotEqualTo, 0.0f);
 
     RE::ConditionCheckParams params(const_cast<RE::TESObjectREFR*>(actor->As<RE::TESObjectREFR>()), nullptr);
     return cond(params);
@@ -99,14 +156,8 @@ bool isInPairedAnimation(const RE::Actor* actor)
 
 bool getDetected(const RE::Actor* attacker, const RE::Actor* victim)
 {
-    static RE::TESConditionItem cond;
-    static std::once_flag       flag;
-    std::call_once(flag, [&]() {
-        cond.data.functionData.function = RE::FUNCTION_DATA::FunctionID::kGetDetected;
-        cond.data.comparisonValue.f     = 0.0f;
-        cond.data.flags.opCode          = RE::CONDITION_ITEM_DATA::OpCode::kNotEqualTo;
-        cond.data.object                = RE::CONDITIONITEMOBJECT::kTarget;
-    });
+    auto cond = makeCondition(RE::FUNCTION_DATA::FunctionID::kGetDetected, RE::CONDITION_ITEM_DATA::OpCode::kNotEqualTo, 0.0f,
+                              RE::CONDITIONITEMOBJECT::kTarget);
 
     RE::ConditionCheckParams params(const_cast<RE::TESObjectREFR*>(attacker->As<RE::TESObjectREFR>()),
                                     const_cast<RE::TESObjectREFR*>(victim->As<RE::TESObjectREFR>()));
@@ -115,18 +166,10 @@ bool getDetected(const RE::Actor* attacker, const RE::Actor* victim)
 
 bool isFurnitureAnimType(const RE::Actor* actor, RE::BSFurnitureMarker::AnimationType type)
 {
-    static RE::TESConditionItem cond;
-    static std::once_flag       flag;
-    std::call_once(flag, [&]() {
-        cond.data.functionData.function = RE::FUNCTION_DATA::FunctionID::kIsFurnitureAnimType;
-        cond.data.flags.opCode          = RE::CONDITION_ITEM_DATA::OpCode::kEqualTo;
-        cond.data.object                = RE::CONDITIONITEMOBJECT::kSelf;
-        cond.data.comparisonValue.f     = 1.0f;
-    });
-
-    ConditionParam cond_param;
-    cond_param.i                     = static_cast<int32_t>(type);
-    cond.data.functionData.params[0] = std::bit_cast<void*>(cond_param);
+    ConditionParam cond_param = {.form = nullptr};
+    cond_param.i              = static_cast<int32_t>(type);
+    auto cond                 = makeCondition(RE::FUNCTION_DATA::FunctionID::kIsFurnitureAnimType, RE::CONDITION_ITEM_DATA::OpCode::kEqualTo, 1.0f,
+                                              RE::CONDITIONITEMOBJECT::kSelf, cond_param);
 
     RE::ConditionCheckParams params(const_cast<RE::TESObjectREFR*>(actor->As<RE::TESObjectREFR>()), nullptr);
     return cond(params);
@@ -134,23 +177,36 @@ bool isFurnitureAnimType(const RE::Actor* actor, RE::BSFurnitureMarker::Animatio
 
 bool shouldAttackKill(const RE::Actor* attacker, const RE::Actor* victim)
 {
-    static RE::TESConditionItem cond;
-    static std::once_flag       flag;
-    std::call_once(flag, [&]() {
-        cond.data.functionData.function = RE::FUNCTION_DATA::FunctionID::kShouldAttackKill;
-        cond.data.flags.opCode          = RE::CONDITION_ITEM_DATA::OpCode::kEqualTo;
-        cond.data.comparisonValue.f     = 1.0f;
-    });
-
-    ConditionParam cond_param;
-    cond_param.form                  = const_cast<RE::TESObjectREFR*>(victim->As<RE::TESObjectREFR>());
-    cond.data.functionData.params[0] = std::bit_cast<void*>(cond_param);
+    auto cond = makeCondition(RE::FUNCTION_DATA::FunctionID::kShouldAttackKill, RE::CONDITION_ITEM_DATA::OpCode::kEqualTo, 1.0f,
+                              RE::CONDITIONITEMOBJECT::kSelf, {.form = const_cast<RE::TESObjectREFR*>(victim->As<RE::TESObjectREFR>())});
 
     RE::ConditionCheckParams params(const_cast<RE::TESObjectREFR*>(attacker->As<RE::TESObjectREFR>()),
                                     const_cast<RE::TESObjectREFR*>(victim->As<RE::TESObjectREFR>()));
     return cond(params);
 }
 
+bool compareCondition(float value, const RE::CONDITION_ITEM_DATA& cond_data)
+{
+    float rhs = cond_data.flags.global ? cond_data.comparisonValue.g->value : cond_data.comparisonValue.f;
+    switch (cond_data.flags.opCode)
+    {
+        case RE::CONDITION_ITEM_DATA::OpCode::kEqualTo:
+            return value == rhs;
+        case RE::CONDITION_ITEM_DATA::OpCode::kNotEqualTo:
+            return value != rhs;
+        case RE::CONDITION_ITEM_DATA::OpCode::kGreaterThan:
+            return value > rhs;
+        case RE::CONDITION_ITEM_DATA::OpCode::kGreaterThanOrEqualTo:
+            return value >= rhs;
+        case RE::CONDITION_ITEM_DATA::OpCode::kLessThan:
+            return value < rhs;
+        case RE::CONDITION_ITEM_DATA::OpCode::kLessThanOrEqualTo:
+            return value <= rhs;
+        default:
+            return false;
+    }
+}
+
 
 bool isLastHostileInRange(const RE::Actor* attacker, const RE::Actor* victim, float range)
 {
@@ -193,6 +249,11 @@ bool isLastHostileInRange(const RE::Actor* attacker, const RE::Actor* victim, fl
     return true;
 }
 
+bool animPlayable(const RE::Actor* actor)
+{
+    return actor->Is3DLoaded() && !actor->IsDisabled() && !actor->IsDead() && !PairedTracker::getSingleton()->isPaired(actor) && !actor->IsOnMount() && !actor->IsInRagdollState();
+}
+
 RE::Actor* getNearestNPC(RE::Actor* origin, float max_range)
 {
     logger::debug("getNearestNPC");
@@ -236,7 +297,11 @@ void playPairedIdle(RE::TESIdleForm* idle, RE::Actor* attacker, RE::Actor* victi
 {
     auto edid = idle->GetFormEditorID();
     logger::debug("Now playing {} between {} and {}", edid, attacker->GetName(), victim->GetName());
-    _playPairedIdle(attacker->GetActorRuntimeData().currentProcess, attacker, RE::DEFAULT_OBJECT::kActionIdle, idle, true, false, victim);
+    if (_playPairedIdle(attacker->GetActorRuntimeData().currentProcess, attacker, RE::DEFAULT_OBJECT::kActionIdle, idle, true, false, victim))
+    {
+        PairedTracker::getSingleton()->start(attacker);
+        PairedTracker::getSingleton()->start(victim);
+    }
     kaputt::setStatusMessage(std::format("Last played by this mod: {}", edid)); // notify menu
 }
 void testPlayPairedIdle(RE::TESIdleForm* idle, float max_range)
@@ -257,113 +322,109 @@ void testPlayPairedIdle(RE::TESIdleForm* idle, float max_range)
     playPairedIdle(idle, player, victim);
 }
 
-std::string getSkeletonRace(const RE::Actor* actor)
+// skeleton model -> id in skeleton_tags
+constexpr std::array<std::pair<std::string_view, uint8_t>, 46> skeleton_models = {{
+    {"Actors\\DLC02\\DwarvenBallistaCenturion\\Character Assets\\skeleton.nif"sv, 0},
+    {"Actors\\Bear\\Character Assets\\skeleton.nif"sv,                            1},
+    {"Actors\\DLC02\\BoarRiekling\\Character Assets\\SkeletonBoar.nif"sv,         2},
+    {"Actors\\DwarvenSteamCenturion\\Character Assets\\skeleton.nif"sv,           3},
+    {"Actors\\DLC01\\ChaurusFlyer\\Character Assets\\skeleton.nif"sv,             4},
+    {"Actors\\Dragon\\Character Assets\\Skeleton.nif"sv,                          5},
+    {"Actors\\Draugr\\Character Assets\\Skeleton.nif"sv,                          6},
+    {"Actors\\Draugr\\Character Assets\\SkeletonF.nif"sv,                         6},
+    {"Actors\\Draugr\\Character Assets\\SkeletonS.nif"sv,                         7},
+    {"Actors\\Falmer\\Character Assets\\Skeleton.nif"sv,                          8},
+    {"Actors\\DLC01\\VampireBrute\\Character Assets\\skeleton.nif"sv,             9},
+    {"Actors\\Giant\\Character Assets\\skeleton.nif"sv,                           10},
+    {"Actors\\Hagraven\\Character Assets\\skeleton.nif"sv,                        11},
+    {"Actors\\DLC02\\BenthicLurker\\Character Assets\\skeleton.nif"sv,            12},
+    {"Actors\\DLC02\\Riekling\\Character Assets\\skeleton.nif"sv,                 13},
+    {"Actors\\SabreCat\\Character Assets\\Skeleton.nif"sv,                        14},
+    {"Actors\\DLC02\\Scrib\\Character Assets\\skeleton.nif"sv,                    15},
+    {"Actors\\FrostbiteSpider\\Character Assets\\skeleton.nif"sv,                 16},
+    {"Actors\\Spriggan\\Character Assets\\skeleton.nif"sv,                        17},
+    {"Actors\\Troll\\Character Assets\\skeleton.nif"sv,                           18},
+    {"Actors\\Canine\\Character Assets Wolf\\skeleton.nif"sv,                     19},
+    {"Actors\\WerewolfBeast\\Character Assets\\skeleton.nif"sv,                   20},
+    {"Actors\\VampireLord\\Character Assets\\Skeleton.nif"sv,                     21},
+    {"Actors\\Chaurus\\Character Assets\\skeleton.nif"sv,                         22},
+    {"Actors\\Deer\\Character Assets\\Skeleton.nif"sv,                            23},
+    {"Actors\\Canine\\Character Assets Dog\\skeleton.nif"sv,                      24},
+    {"Actors\\DragonPriest\\Character Assets\\skeleton.nif"sv,                    25},
+    {"Actors\\DwarvenSphereCenturion\\Character Assets\\skeleton.nif"sv,          26},
+    {"Actors\\DwarvenSpider\\Character Assets\\skeleton.nif"sv,                   27},
+    {"Actors\\AtronachFlame\\Character Assets\\skeleton.nif"sv,                   28},
+    {"Actors\\AtronachFrost\\Character Assets\\skeleton.nif"sv,                   29},
+    {"Actors\\AtronachStorm\\Character Assets\\skeleton.nif"sv,                   30},
+    {"Actors\\Goat\\Character Assets\\skeleton.nif"sv,                            31},
+    {"Actors\\Horker\\Character Assets\\skeleton.nif"sv,                          32},
+    {"Actors\\Horse\\Character Assets\\skeleton.nif"sv,                           33},
+    {"Actors\\IceWraith\\Character Assets\\skeleton.nif"sv,                       34},
+    {"Actors\\Mammoth\\Character Assets\\skeleton.nif"sv,                         35},
+    {"Actors\\Skeever\\Character Assets\\skeleton.nif"sv,                         36},
+    {"Actors\\Slaughterfish\\Character Assets\\skeleton.nif"sv,                   37},
+    {"Actors\\Wisp\\Character Assets\\skeleton.nif"sv,                            38},
+    {"Actors\\Witchlight\\Character Assets\\skeleton.nif"sv,                      39},
+    {"Actors\\Cow\\Character Assets\\skeleton.nif"sv,                             40},
+    {"Actors\\Ambient\\Hare\\Character Assets\\skeleton.nif"sv,                   41},
+    {"Actors\\Mudcrab\\Character Assets\\skeleton.nif"sv,                         42},
+    {"Actors\\DLC02\\HMDaedra\\Character Assets\\Skeleton.nif"sv,                 43},
+    {"Actors\\DLC02\\Netch\\CharacterAssets\\skeleton.nif"sv,                     44}
+}};
+
+uint8_t getSkeletonId(const RE::Actor* actor)
 {
-    auto skel = actor->GetRace()->skeletonModels[actor->GetActorBase()->IsFemale()].model;
-    // if (!_stricmp(skel.c_str(), "Actors\\Character\\Character Assets\\skeleton.nif")) return "human";
-    // if (!_stricmp(skel.c_str(), "actors\\Character\\Character Assets Female\\skeleton_female.nif")) return "human";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\DwarvenBallistaCenturion\\Character Assets\\skeleton.nif")) return "ballista";
-    if (!_stricmp(skel.c_str(), "Actors\\Bear\\Character Assets\\skeleton.nif")) return "bear";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\BoarRiekling\\Character Assets\\SkeletonBoar.nif")) return "boar";
-    if (!_stricmp(skel.c_str(), "Actors\\DwarvenSteamCenturion\\Character Assets\\skeleton.nif")) return "centurion";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC01\\ChaurusFlyer\\Character Assets\\skeleton.nif")) return "chaurushunter";
-    if (!_stricmp(skel.c_str(), "Actors\\Dragon\\Character Assets\\Skeleton.nif")) return "dragon";
-    if (!_stricmp(skel.c_str(), "Actors\\Draugr\\Character Assets\\Skeleton.nif")) return "draugr";
-    if (!_stricmp(skel.c_str(), "Actors\\Draugr\\Character Assets\\SkeletonF.nif")) return "draugr";
-    if (!_stricmp(skel.c_str(), "Actors\\Draugr\\Character Assets\\SkeletonS.nif")) return "skeleton";
-    if (!_stricmp(skel.c_str(), "Actors\\Falmer\\Character Assets\\Skeleton.nif")) return "falmer";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC01\\VampireBrute\\Character Assets\\skeleton.nif")) return "gargoyle";
-    if (!_stricmp(skel.c_str(), "Actors\\Giant\\Character Assets\\skeleton.nif")) return "giant";
-    if (!_stricmp(skel.c_str(), "Actors\\Hagraven\\Character Assets\\skeleton.nif")) return "hagraven";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\BenthicLurker\\Character Assets\\skeleton.nif")) return "lurker";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\Riekling\\Character Assets\\skeleton.nif")) return "riekling";
-    if (!_stricmp(skel.c_str(), "Actors\\SabreCat\\Character Assets\\Skeleton.nif")) return "sabrecat";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\Scrib\\Character Assets\\skeleton.nif")) return "ashhopper";
-    if (!_stricmp(skel.c_str(), "Actors\\FrostbiteSpider\\Character Assets\\skeleton.nif")) return "spider";
-    if (!_stricmp(skel.c_str(), "Actors\\Spriggan\\Character Assets\\skeleton.nif")) return "spriggan";
-    if (!_stricmp(skel.c_str(), "Actors\\Troll\\Character Assets\\skeleton.nif")) return "troll";
-    if (!_stricmp(skel.c_str(), "Actors\\Canine\\Character Assets Wolf\\skeleton.nif")) return "wolf";
-    if (!_stricmp(skel.c_str(), "Actors\\WerewolfBeast\\Character Assets\\skeleton.nif")) return "werewolf";
-    if (!_stricmp(skel.c_str(), "Actors\\VampireLord\\Character Assets\\Skeleton.nif")) return "vamplord";
-    if (!_stricmp(skel.c_str(), "Actors\\Chaurus\\Character Assets\\skeleton.nif")) return "chaurus";
-    if (!_stricmp(skel.c_str(), "Actors\\Deer\\Character Assets\\Skeleton.nif")) return "deer";
-    if (!_stricmp(skel.c_str(), "Actors\\Canine\\Character Assets Dog\\skeleton.nif")) return "dog";
-    if (!_stricmp(skel.c_str(), "Actors\\DragonPriest\\Character Assets\\skeleton.nif")) return "priest";
-    if (!_stricmp(skel.c_str(), "Actors\\DwarvenSphereCenturion\\Character Assets\\skeleton.nif")) return "sphere";
-    if (!_stricmp(skel.c_str(), "Actors\\DwarvenSpider\\Character Assets\\skeleton.nif")) return "dwarvenspider";
-    if (!_stricmp(skel.c_str(), "Actors\\AtronachFlame\\Character Assets\\skeleton.nif")) return "flameatronach";
-    if (!_stricmp(skel.c_str(), "Actors\\AtronachFrost\\Character Assets\\skeleton.nif")) return "frostatronach";
-    if (!_stricmp(skel.c_str(), "Actors\\AtronachStorm\\Character Assets\\skeleton.nif")) return "stormatronach";
-    if (!_stricmp(skel.c_str(), "Actors\\Goat\\Character Assets\\skeleton.nif")) return "goat";
-    if (!_stricmp(skel.c_str(), "Actors\\Horker\\Character Assets\\skeleton.nif")) return "horker";
-    if (!_stricmp(skel.c_str(), "Actors\\Horse\\Character Assets\\skeleton.nif")) return "horse";
-    if (!_stricmp(skel.c_str(), "Actors\\IceWraith\\Character Assets\\skeleton.nif")) return "wraith";
-    if (!_stricmp(skel.c_str(), "Actors\\Mammoth\\Character Assets\\skeleton.nif")) return "mammoth";
-    if (!_stricmp(skel.c_str(), "Actors\\Skeever\\Character Assets\\skeleton.nif")) return "skeever";
-    if (!_stricmp(skel.c_str(), "Actors\\Slaughterfish\\Character Assets\\skeleton.nif")) return "slaughterfish";
-    if (!_stricmp(skel.c_str(), "Actors\\Wisp\\Character Assets\\skeleton.nif")) return "wisp";
-    if (!_stricmp(skel.c_str(), "Actors\\Witchlight\\Character Assets\\skeleton.nif")) return "witchlight";
-    if (!_stricmp(skel.c_str(), "Actors\\Cow\\Character Assets\\skeleton.nif")) return "cow";
-    if (!_stricmp(skel.c_str(), "Actors\\Ambient\\Hare\\Character Assets\\skeleton.nif")) return "rabbit";
-    if (!_stricmp(skel.c_str(), "Actors\\Mudcrab\\Character Assets\\skeleton.nif")) return "mudcrab";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\HMDaedra\\Character Assets\\Skeleton.nif")) return "seeker";
-    if (!_stricmp(skel.c_str(), "Actors\\DLC02\\Netch\\CharacterAssets\\skeleton.nif")) return "netch";
-    return {};
+    struct SkeletonIds
+    {
+        std::array<uint8_t, 2> ids = {0xFF, 0xFF}; // male, female
+    };
+    static FormTable<SkeletonIds, 512> cache = {}; // by race
+    static std::mutex                  lock  = {};
+
+    auto race = actor->GetRace();
+    auto sex  = actor->GetActorBase()->IsFemale() ? 1 : 0;
+    if (!race)
+        return skeleton_other;
+
+    std::lock_guard guard(lock);
+    auto&           id = cache.getOrInsert(race->GetFormID()).ids[sex];
+    if (id == 0xFF)
+    {
+        auto skel = race->skeletonModels[sex].model;
+        auto it   = std::ranges::find_if(skeleton_models, [&](auto const& model) { return !_stricmp(skel.c_str(), model.first.data()); });
+        id        = (it == skeleton_models.end()) ? skeleton_other : it->second;
+    }
+    return id;
 }
 
-StrSet getBannedSkels(const RE::Actor* actor, std::string_view prefix)
+std::string_view getSkeletonRace(const RE::Actor* actor)
 {
-    StrSet      banned = {};
-    std::string prefix_str{prefix};
-    auto        skel = actor->GetRace()->skeletonModels[actor->GetActorBase()->IsFemale()].model;
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\DwarvenBallistaCenturion\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "ballista");
-    if (_stricmp(skel.c_str(), "Actors\\Bear\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "bear");
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\BoarRiekling\\Character Assets\\SkeletonBoar.nif")) banned.insert(prefix_str + "boar");
-    if (_stricmp(skel.c_str(), "Actors\\DwarvenSteamCenturion\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "centurion");
-    if (_stricmp(skel.c_str(), "Actors\\DLC01\\ChaurusFlyer\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "chaurushunter");
-    if (_stricmp(skel.c_str(), "Actors\\Dragon\\Character Assets\\Skeleton.nif")) banned.insert(prefix_str + "dragon");
-    if (_stricmp(skel.c_str(), "Actors\\Draugr\\Character Assets\\Skeleton.nif") &&
-        _stricmp(skel.c_str(), "Actors\\Draugr\\Character Assets\\SkeletonF.nif")) banned.insert(prefix_str + "draugr");
-    if (_stricmp(skel.c_str(), "Actors\\Draugr\\Character Assets\\SkeletonS.nif")) banned.insert(prefix_str + "skeleton");
-    if (_stricmp(skel.c_str(), "Actors\\Falmer\\Character Assets\\Skeleton.nif")) banned.insert(prefix_str + "falmer");
-    if (_stricmp(skel.c_str(), "Actors\\DLC01\\VampireBrute\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "gargoyle");
-    if (_stricmp(skel.c_str(), "Actors\\Giant\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "giant");
-    if (_stricmp(skel.c_str(), "Actors\\Hagraven\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "hagraven");
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\BenthicLurker\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "lurker");
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\Riekling\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "riekling");
-    if (_stricmp(skel.c_str(), "Actors\\SabreCat\\Character Assets\\Skeleton.nif")) banned.insert(prefix_str + "sabrecat");
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\Scrib\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "ashhopper");
-    if (_stricmp(skel.c_str(), "Actors\\FrostbiteSpider\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "spider");
-    if (_stricmp(skel.c_str(), "Actors\\Spriggan\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "spriggan");
-    if (_stricmp(skel.c_str(), "Actors\\Troll\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "troll");
-    if (_stricmp(skel.c_str(), "Actors\\Canine\\Character Assets Wolf\\skeleton.nif")) banned.insert(prefix_str + "wolf");
-    if (_stricmp(skel.c_str(), "Actors\\WerewolfBeast\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "werewolf");
-    if (_stricmp(skel.c_str(), "Actors\\VampireLord\\Character Assets\\Skeleton.nif")) banned.insert(prefix_str + "vamplord");
-    if (_stricmp(skel.c_str(), "Actors\\Chaurus\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "chaurus");
-    if (_stricmp(skel.c_str(), "Actors\\Deer\\Character Assets\\Skeleton.nif")) banned.insert(prefix_str + "deer");
-    if (_stricmp(skel.c_str(), "Actors\\Canine\\Character Assets Dog\\skeleton.nif")) banned.insert(prefix_str + "dog");
-    if (_stricmp(skel.c_str(), "Actors\\DragonPriest\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "priest");
-    if (_stricmp(skel.c_str(), "Actors\\DwarvenSphereCenturion\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "sphere");
-    if (_stricmp(skel.c_str(), "Actors\\DwarvenSpider\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "dwarvenspider");
-    if (_stricmp(skel.c_str(), "Actors\\AtronachFlame\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "flameatronach");
-    if (_stricmp(skel.c_str(), "Actors\\AtronachFrost\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "frostatronach");
-    if (_stricmp(skel.c_str(), "Actors\\AtronachStorm\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "stormatronach");
-    if (_stricmp(skel.c_str(), "Actors\\Goat\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "goat");
-    if (_stricmp(skel.c_str(), "Actors\\Horker\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "horker");
-    if (_stricmp(skel.c_str(), "Actors\\Horse\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "horse");
-    if (_stricmp(skel.c_str(), "Actors\\IceWraith\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "wraith");
-    if (_stricmp(skel.c_str(), "Actors\\Mammoth\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "mammoth");
-    if (_stricmp(skel.c_str(), "Actors\\Skeever\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "skeever");
-    if (_stricmp(skel.c_str(), "Actors\\Slaughterfish\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "slaughterfish");
-    if (_stricmp(skel.c_str(), "Actors\\Wisp\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "wisp");
-    if (_stricmp(skel.c_str(), "Actors\\Witchlight\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "witchlight");
-    if (_stricmp(skel.c_str(), "Actors\\Cow\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "cow");
-    if (_stricmp(skel.c_str(), "Actors\\Ambient\\Hare\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "rabbit");
-    if (_stricmp(skel.c_str(), "Actors\\Mudcrab\\Character Assets\\skeleton.nif")) banned.insert(prefix_str + "mudcrab");
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\HMDaedra\\Character Assets\\Skeleton.nif")) banned.insert(prefix_str + "seeker");
-    if (_stricmp(skel.c_str(), "Actors\\DLC02\\Netch\\CharacterAssets\\skeleton.nif")) banned.insert(prefix_str + "netch");
-
-    return banned;
+    auto id = getSkeletonId(actor);
+    return (id == skeleton_other) ? std::string_view{} : skeleton_tags[id];
 }
 
+std::optional<std::pair<std::string_view, RE::FormID>> parseFormRef(std::string_view ref)
+{
+    auto sep = ref.find('|');
+    if (sep == std::string_view::npos)
+        return std::nullopt;
+
+    auto plugin = ref.substr(0, sep);
+    auto id_str = ref.substr(sep + 1);
+    if (id_str.starts_with("0x") || id_str.starts_with("0X"))
+        id_str.remove_prefix(2);
+
+    RE::FormID local_id = 0;
+    auto [end, ec]      = std::from_chars(id_str.data(), id_str.data() + id_str.size(), local_id, 16);
+    if (plugin.empty() || id_str.empty() || (ec != std::errc{}) || (end != id_str.data() + id_str.size()))
+        return std::nullopt;
+    return std::pair{plugin, local_id};
+}
+
+RE::FormID getFullFormID(const RE::TESFile* file, RE::FormID local_id)
+{
+    if (file->IsLight())
+        return 0xFE000000 | (static_cast<RE::FormID>(file->smallFileCompileIndex) << 12) | (local_id & 0xFFF);
+    return (static_cast<RE::FormID>(file->compileIndex) << 24) | (local_id & 0xFFFFFF);
+}
 } // namespace kaputt
\ No newline at end of file
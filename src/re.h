@@ -27,6 +27,7 @@ struct UpdateHook
 {
     static void                                    thunk(RE::Main* a_this, float a2);
     static inline REL::Relocation<decltype(thunk)> func;
+    static inline std::atomic_uint64_t             frame = 0; // frames since the hook was installed
 
     static constexpr auto id     = RELOCATION_ID(35551, 36544);
     static constexpr auto offset = REL::VariantOffset(0x11F, 0x160, 0x0); // VR Unknown
@@ -56,6 +57,40 @@ public:
     }
 };
 
+// graph events of the actors PairedTracker has checked, for when their paired idles start and end
+class PairedAnimGraphEventSink : public RE::BSTEventSink<RE::BSAnimationGraphEvent>
+{
+public:
+    virtual EventResult ProcessEvent(const RE::BSAnimationGraphEvent* a_event, RE::BSTEventSource<RE::BSAnimationGraphEvent>* a_eventSource);
+    static void         RegisterSink(const RE::Actor* actor)
+    {
+        static PairedAnimGraphEventSink _sink;
+        actor->AddAnimationGraphEventSink(&_sink); // no duplicates
+    }
+};
+
+class EquipEventSink : public RE::BSTEventSink<RE::TESEquipEvent>
+{
+public:
+    virtual EventResult ProcessEvent(const RE::TESEquipEvent* a_event, RE::BSTEventSource<RE::TESEquipEvent>* a_eventSource);
+    static void         RegisterSink()
+    {
+        static EquipEventSink _sink;
+        RE::ScriptEventSourceHolder::GetSingleton()->AddEventSink(&_sink);
+    }
+};
+
+class ObjectLoadedEventSink : public RE::BSTEventSink<RE::TESObjectLoadedEvent>
+{
+public:
+    virtual EventResult ProcessEvent(const RE::TESObjectLoadedEvent* a_event, RE::BSTEventSource<RE::TESObjectLoadedEvent>* a_eventSource);
+    static void         RegisterSink()
+    {
+        static ObjectLoadedEventSink _sink;
+        RE::ScriptEventSourceHolder::GetSingleton()->AddEventSink(&_sink);
+    }
+};
+
 /* ------------- ENGINE FUNC ------------- */
 
 inline bool _playPairedIdle(RE::AIProcess* proc, RE::Actor* attacker, RE::DEFAULT_OBJECT smth, RE::TESIdleForm* idle, bool a5, bool a6, RE::TESObjectREFR* target)
@@ -78,6 +113,7 @@ bool isInPairedAnimation(const RE::Actor* actor);
 bool getDetected(const RE::Actor* attacker, const RE::Actor* victim);
 bool isFurnitureAnimType(const RE::Actor* actor, RE::BSFurnitureMarker::AnimationType type);
 bool shouldAttackKill(const RE::Actor* attacker, const RE::Actor* victim);
+bool compareCondition(float value, const RE::CONDITION_ITEM_DATA& cond_data); // value of the function against the item's comparison
 
 /* ------------- CUSTOM FUNC ------------- */
 
@@ -87,10 +123,7 @@ inline bool isGamePaused()
     return !UI || UI->GameIsPaused();
 }
 
-inline bool animPlayable(const RE::Actor* actor)
-{
-    return actor->Is3DLoaded() && !actor->IsDisabled() && !actor->IsDead() && !isInPairedAnimation(actor) && !actor->IsOnMount() && !actor->IsInRagdollState();
-}
+bool animPlayable(const RE::Actor* actor);
 
 RE::Actor* getNearestNPC(RE::Actor* origin, float max_range = 256);
 bool       isLastHostileInRange(const RE::Actor* attacker, const RE::Actor* victim, float range);
@@ -107,7 +140,22 @@ inline float getDamageMult(bool is_victim_player)
     return setting->data.f;
 }
 
-std::string getSkeletonRace(const RE::Actor* actor);
-StrSet      getBannedSkels(const RE::Actor* actor, std::string_view prefix);
+// Creature skeletons that have a_<tag> and v_<tag> anim tags. Anims without such a tag are
+// for every skeleton, anims with one are only for that skeleton.
+inline constexpr std::array skeleton_tags = {
+    "ballista"sv, "bear"sv, "boar"sv, "centurion"sv, "chaurushunter"sv, "dragon"sv, "draugr"sv, "skeleton"sv,
+    "falmer"sv, "gargoyle"sv, "giant"sv, "hagraven"sv, "lurker"sv, "riekling"sv, "sabrecat"sv, "ashhopper"sv,
+    "spider"sv, "spriggan"sv, "troll"sv, "wolf"sv, "werewolf"sv, "vamplord"sv, "chaurus"sv, "deer"sv,
+    "dog"sv, "priest"sv, "sphere"sv, "dwarvenspider"sv, "flameatronach"sv, "frostatronach"sv, "stormatronach"sv, "goat"sv,
+    "horker"sv, "horse"sv, "wraith"sv, "mammoth"sv, "skeever"sv, "slaughterfish"sv, "wisp"sv, "witchlight"sv,
+    "cow"sv, "rabbit"sv, "mudcrab"sv, "seeker"sv, "netch"sv};
+inline constexpr uint8_t skeleton_other = static_cast<uint8_t>(skeleton_tags.size()); // humanoids and anything not listed
+
+uint8_t          getSkeletonId(const RE::Actor* actor);   // index into skeleton_tags or skeleton_other, cached per race
+std::string_view getSkeletonRace(const RE::Actor* actor); // its skeleton tag, empty for skeleton_other
+
+// "Plugin.esp|0x00ABCD" -> plugin name and local FormID, nullopt if ref isn't in that form
+std::optional<std::pair<std::string_view, RE::FormID>> parseFormRef(std::string_view ref);
+RE::FormID                                             getFullFormID(const RE::TESFile* file, RE::FormID local_id); // file must be loaded
 
 } // namespace kaputt
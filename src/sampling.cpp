@@ -0,0 +1,95 @@
+#include "sampling.h"
+
+namespace kaputt
+{
+void AliasTable::build(std::span<const float> weights)
+{
+    size_t n = weights.size();
+    prob.assign(n, 1.f);
+    alias.resize(n);
+    std::iota(alias.begin(), alias.end(), 0);
+
+    double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if (n == 0 || total <= 0.0)
+        return;
+
+    std::vector<double>   scaled(n);
+    std::vector<uint32_t> small, large;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        scaled[i] = weights[i] * static_cast<double>(n) / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        auto less = small.back();
+        auto more = large.back();
+        small.pop_back();
+        large.pop_back();
+
+        prob[less]  = static_cast<float>(scaled[less]);
+        alias[less] = more;
+
+        scaled[more] -= 1.0 - scaled[less];
+        (scaled[more] < 1.0 ? small : large).push_back(more);
+    }
+    // whatever is left is 1 up to rounding, already set
+}
+
+const AliasTable* WeightedSampler::getTable(uint64_t key, const std::vector<uint32_t>& candidates, const std::vector<float>& weights)
+{
+    if (candidates.empty())
+        return nullptr;
+
+    ++clock;
+    auto& entry = cache[key];
+    if ((entry.size != candidates.size()) || (entry.front != candidates.front()) || (entry.back != candidates.back())) // new set or a collision
+        entry = {.size = candidates.size(), .front = candidates.front(), .back = candidates.back()};
+    entry.last_used = clock;
+
+    if (++entry.seen == build_after)
+    {
+        std::vector<float> cand_weights;
+        cand_weights.reserve(candidates.size());
+        for (auto anim_idx : candidates)
+            cand_weights.push_back(weights[anim_idx]);
+        entry.table.build(cand_weights);
+    }
+
+    const AliasTable* table = (entry.seen >= build_after) ? &entry.table : nullptr;
+    if (cache.size() > max_entries)
+        evict(); // never the entry just used
+    return table;
+}
+
+uint32_t WeightedSampler::pick(const AliasTable* table, const std::vector<uint32_t>& candidates, const std::vector<float>& weights, Rng& rng)
+{
+    if (!table || (table->size() != candidates.size()))
+        return pickPrefixSum(candidates, weights, rng);
+
+    auto column = rng.bounded(static_cast<uint32_t>(table->size()));
+    auto coin   = rng.uniform();
+    return candidates[table->sample(column, coin)];
+}
+
+uint32_t WeightedSampler::pickPrefixSum(const std::vector<uint32_t>& candidates, const std::vector<float>& weights, Rng& rng)
+{
+    sums.resize(candidates.size());
+    float total = 0.f;
+    for (size_t i = 0; i < candidates.size(); ++i)
+        sums[i] = (total += weights[candidates[i]]);
+
+    auto target = rng.uniform() * total;
+    auto it     = std::upper_bound(sums.begin(), sums.end(), target);
+    if (it == sums.end()) // rounding
+        --it;
+    return candidates[it - sums.begin()];
+}
+
+void WeightedSampler::evict()
+{
+    auto oldest = std::ranges::min_element(cache, {}, [](auto const& item) { return item.second.last_used; });
+    cache.erase(oldest);
+}
+} // namespace kaputt
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "random.h"
+
+namespace kaputt
+{
+// Vose alias table, draws from a fixed discrete distribution in O(1).
+class AliasTable
+{
+public:
+    void build(std::span<const float> weights); // weights must be positive
+
+    // column in [0, size), coin in [0, 1)
+    uint32_t sample(size_t column, float coin) const { return (coin < prob[column]) ? static_cast<uint32_t>(column) : alias[column]; }
+    size_t   size() const { return prob.size(); }
+
+private:
+    std::vector<float>    prob  = {};
+    std::vector<uint32_t> alias = {};
+};
+
+// Weighted pick over a candidate set of anim indices.
+// Alias tables are kept for candidate sets that come up repeatedly, other sets use
+// a binary search over the prefix sums.
+class WeightedSampler
+{
+public:
+    // Table for the set under key, nullptr until the set was seen build_after times. Call once per
+    // submit. The key stands for the set, e.g. a hash of the filter inputs that produced it.
+    const AliasTable* getTable(uint64_t key, const std::vector<uint32_t>& candidates, const std::vector<float>& weights);
+
+    // weights indexed by anim index, candidates must all have a positive weight, table from getTable or nullptr
+    uint32_t pick(const AliasTable* table, const std::vector<uint32_t>& candidates, const std::vector<float>& weights, Rng& rng);
+    void     clear() { cache.clear(); }
+
+private:
+    struct Entry
+    {
+        size_t     size      = 0; // of the set, with its ends to catch key collisions
+        uint32_t   front     = 0;
+        uint32_t   back      = 0;
+        AliasTable table     = {};
+        uint32_t   seen      = 0;
+        uint64_t   last_used = 0;
+    };
+
+    static constexpr size_t   max_entries = 32;
+    static constexpr uint32_t build_after = 2; // a set must be seen this many times to get a table
+
+    std::unordered_map<uint64_t, Entry> cache = {}; // key -> entry
+    std::vector<float>                  sums  = {}; // scratch for prefix sums
+    uint64_t                            clock = 0;
+
+    uint32_t pickPrefixSum(const std::vector<uint32_t>& candidates, const std::vector<float>& weights, Rng& rng);
+    void     evict();
+};
+} // namespace kaputt
@@ -0,0 +1,60 @@
+#include "search.h"
+
+namespace kaputt
+{
+void TrigramIndex::build(std::vector<std::string_view> new_keys)
+{
+    clear();
+    keys = std::move(new_keys);
+
+    for (uint32_t key_idx = 0; key_idx < keys.size(); ++key_idx)
+    {
+        auto key = keys[key_idx];
+        for (size_t pos = 0; pos + 3 <= key.size(); ++pos)
+        {
+            auto& posting = postings[trigram(key, pos)];
+            if (posting.empty() || (posting.back() != key_idx)) // trigram repeated within a key
+                posting.push_back(key_idx);
+        }
+    }
+}
+
+void TrigramIndex::clear()
+{
+    keys.clear();
+    postings.clear();
+}
+
+std::vector<uint32_t> TrigramIndex::find(std::string_view substr) const
+{
+    std::vector<uint32_t> result = {};
+
+    if (substr.size() < 3) // too short to use the index
+    {
+        for (uint32_t key_idx = 0; key_idx < keys.size(); ++key_idx)
+            if (keys[key_idx].contains(substr))
+                result.push_back(key_idx);
+        return result;
+    }
+
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (size_t pos = 0; pos + 3 <= substr.size(); ++pos)
+    {
+        auto posting = postings.find(trigram(substr, pos));
+        if (posting == postings.end())
+            return result;
+        lists.push_back(&posting->second);
+    }
+    std::ranges::sort(lists, {}, [](auto list) { return list->size(); });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    // intersect starting from the rarest trigram
+    result = *lists.front();
+    for (auto list = lists.begin() + 1; (list != lists.end()) && !result.empty(); ++list)
+        std::erase_if(result, [&](uint32_t key_idx) { return !std::ranges::binary_search(**list, key_idx); });
+
+    // trigrams may appear in the wrong order or apart
+    std::erase_if(result, [&](uint32_t key_idx) { return !keys[key_idx].contains(substr); });
+    return result;
+}
+} // namespace kaputt
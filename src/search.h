@@ -0,0 +1,26 @@
+#pragma once
+
+namespace kaputt
+{
+// Substring index over a fixed list of keys. Each trigram maps to the sorted list of keys
+// containing it, so a query only verifies the keys that have all of its trigrams.
+class TrigramIndex
+{
+public:
+    void build(std::vector<std::string_view> new_keys); // the views must outlive the index
+    void clear();
+
+    std::vector<uint32_t> find(std::string_view substr) const; // ascending key indices
+
+    const std::vector<std::string_view>& getKeys() const { return keys; }
+
+private:
+    std::vector<std::string_view>                       keys     = {};
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings = {};
+
+    static uint32_t trigram(std::string_view str, size_t pos)
+    {
+        return static_cast<uint8_t>(str[pos]) | (static_cast<uint8_t>(str[pos + 1]) << 8) | (static_cast<uint8_t>(str[pos + 2]) << 16);
+    }
+};
+} // namespace kaputt
@@ -0,0 +1,54 @@
+#include "submit.h"
+
+#include "re.h"
+#include "tasks.h"
+#include "kaputt.h"
+
+namespace kaputt
+{
+void SubmitWorker::queue(SubmitSnapshot snapshot, Callback on_done)
+{
+    {
+        std::scoped_lock l(queue_mutex);
+        pending.push_back({std::move(snapshot), std::move(on_done)});
+        if (!worker.joinable())
+            worker = std::jthread([this](std::stop_token stop_token) { run(stop_token); });
+    }
+    queue_cv.notify_one();
+}
+
+void SubmitWorker::run(std::stop_token stop_token)
+{
+    while (true)
+    {
+        std::vector<Job> jobs;
+        {
+            std::unique_lock l(queue_mutex);
+            if (!queue_cv.wait(l, stop_token, [this] { return !pending.empty(); }))
+                return;
+            jobs.swap(pending);
+        }
+
+        for (auto& job : jobs)
+        {
+            uint32_t anim_idx = 0;
+            auto     reason   = Kaputt::getSingleton()->filterSubmit(job.snapshot, anim_idx);
+
+            // a frame has passed since the snapshot, the actors may be gone or busy by now
+            TaskManager::getSingleton()->addTask(0, [job = std::move(job), reason, anim_idx]() mutable {
+                if (reason == FailReason::kNone)
+                {
+                    auto attacker = job.snapshot.attacker.get();
+                    auto victim   = job.snapshot.victim.get();
+                    if (!attacker || !victim || !animPlayable(attacker.get()) || !animPlayable(victim.get()))
+                        reason = FailReason::kNotPlayable;
+                    else
+                        reason = Kaputt::getSingleton()->commitSubmit(job.snapshot, anim_idx);
+                }
+                if (job.on_done)
+                    job.on_done(reason);
+            });
+        }
+    }
+}
+} // namespace kaputt
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "tags.h"
+#include "query.h"
+#include "random.h"
+#include "history.h"
+
+#include <condition_variable>
+
+namespace kaputt
+{
+enum class FailReason : uint8_t;
+
+// What a submit needs from the game, taken on the game thread and copied by value.
+// Filtering and picking over it don't touch the engine, so they can run on any thread.
+struct SubmitSnapshot
+{
+    RE::ActorHandle attacker = {};
+    RE::ActorHandle victim   = {};
+
+    std::shared_ptr<const AnimIndex>     index       = nullptr; // kept alive until the submit is done
+    std::shared_ptr<const CompiledQuery> param_query = nullptr;
+    std::shared_ptr<const CompiledQuery> info_query  = nullptr;
+
+    uint8_t  att_skel        = 0;
+    uint8_t  vic_skel        = 0;
+    TagBits  req_mask        = {}; // manual tags
+    TagBits  ban_mask        = {};
+    TagBits  tagger_req_mask = {}; // IdleTagger results
+    TagBits  tagger_ban_mask = {};
+    uint64_t set_key         = 0; // hash of the filter inputs above, stands for the candidate set
+
+    std::array<RE::FormID, 2 * PlayHistory::capacity> recent_ids   = {}; // to avoid repeating
+    size_t                                             recent_count = 0;
+
+    Rng rng = {}; // seeded from the selection stream
+};
+
+// Filters and picks for deferred submits on a background thread, the pick is played on the
+// next game tick through the TaskManager.
+class SubmitWorker
+{
+public:
+    using Callback = std::function<void(FailReason)>; // called on the game thread once the submit is settled
+
+    static SubmitWorker* getSingleton()
+    {
+        static SubmitWorker worker;
+        return std::addressof(worker);
+    }
+
+    void queue(SubmitSnapshot snapshot, Callback on_done);
+
+private:
+    struct Job
+    {
+        SubmitSnapshot snapshot = {};
+        Callback       on_done  = nullptr;
+    };
+
+    std::mutex                  queue_mutex;
+    std::condition_variable_any queue_cv;
+    std::vector<Job>            pending = {};
+    std::jthread                worker;
+
+    void run(std::stop_token stop_token);
+};
+} // namespace kaputt
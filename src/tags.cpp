@@ -0,0 +1,99 @@
+#include "tags.h"
+
+#include "utils.h"
+
+namespace kaputt
+{
+size_t TagTable::memoryUsage() const
+{
+    return heapSize(ids) + names.capacity() * sizeof(std::string_view);
+}
+
+StrSet AnimIndex::getTags(uint32_t anim_idx) const
+{
+    StrSet tag_strs;
+    tag_bits[anim_idx].forEach([&](uint32_t id) { tag_strs.emplace(tags.getName(id)); });
+    return tag_strs;
+}
+
+bool AnimIndex::makeMask(const StrSet& tag_strs, TagBits& mask) const
+{
+    bool all_known = true;
+    for (auto const& tag : tag_strs)
+        if (auto id = tags.find(tag); id)
+            mask.set(*id);
+        else
+            all_known = false;
+    return all_known;
+}
+
+TagBits AnimIndex::makeMask(const StrSet& tag_strs) const
+{
+    TagBits mask;
+    makeMask(tag_strs, mask);
+    return mask;
+}
+
+void AnimIndex::buildCoverage(std::span<const std::string_view> skeleton_tags)
+{
+    skeleton_count = skeleton_tags.size() + 1;
+
+    auto fill = [&](std::string_view prefix, std::vector<TagBits>& coverage) {
+        std::vector<std::optional<uint32_t>> skel_ids;
+        for (auto tag : skeleton_tags)
+            skel_ids.push_back(tags.find(std::string{prefix} + std::string{tag}));
+
+        coverage.assign(skeleton_count, {});
+        for (uint32_t anim_idx = 0; anim_idx < size(); ++anim_idx)
+        {
+            if (weights[anim_idx] == 0.f) // weight 0 disables an anim
+                continue;
+
+            size_t own = 0, found = 0;
+            for (size_t skel = 0; skel < skel_ids.size(); ++skel)
+                if (skel_ids[skel] && exp_bits[anim_idx].test(*skel_ids[skel]))
+                    own = skel, ++found;
+
+            if (found == 0)
+                for (auto& bits : coverage)
+                    bits.set(anim_idx);
+            else if (found == 1) // more than one skeleton tag bans the anim everywhere
+                coverage[own].set(anim_idx);
+        }
+    };
+    fill("a_", att_coverage);
+    fill("v_", vic_coverage);
+
+    covered.assign(skeleton_count * skeleton_count, false);
+    for (size_t att = 0; att < skeleton_count; ++att)
+        for (size_t vic = 0; vic < skeleton_count; ++vic)
+            covered[att * skeleton_count + vic] = att_coverage[att].intersects(vic_coverage[vic]);
+}
+
+std::vector<uint32_t> AnimIndex::getCovered(uint8_t att_skel, uint8_t vic_skel) const
+{
+    std::vector<uint32_t> anims;
+    if (!isCovered(att_skel, vic_skel))
+        return anims;
+
+    auto bits = att_coverage[att_skel];
+    bits &= vic_coverage[vic_skel];
+    bits.forEach([&](uint32_t anim_idx) { anims.push_back(anim_idx); });
+    return anims;
+}
+
+size_t AnimIndex::memoryUsage() const
+{
+    size_t bytes = edid_pool.capacity() + edid_offsets.capacity() * sizeof(uint32_t) + tags.memoryUsage() +
+        pack_bits.memoryUsage() + pack_weights.capacity() * sizeof(float) + tag_bits.memoryUsage() + exp_bits.memoryUsage() + weights.capacity() * sizeof(float) +
+        idles.capacity() * sizeof(RE::TESIdleForm*) + pack_ids.capacity() * sizeof(uint16_t) +
+        pack_names.capacity() * sizeof(std::string) + form_ids.capacity() * sizeof(std::pair<RE::FormID, uint32_t>);
+    for (auto const& pack : pack_names)
+        bytes += heapSize(pack);
+    for (auto const& bits : att_coverage)
+        bytes += bits.getWords().size() * sizeof(uint64_t);
+    for (auto const& bits : vic_coverage)
+        bytes += bits.getWords().size() * sizeof(uint64_t);
+    return bytes + covered.capacity() / 8 + (custom_tags.capacity() + custom_weights.capacity()) / 8 + heapSize(tag_expansions);
+}
+} // namespace kaputt
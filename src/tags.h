@@ -0,0 +1,250 @@
+#pragma once
+
+namespace kaputt
+{
+// Growable bitset over tag ids, or anim indices.
+class TagBits
+{
+public:
+    void set(uint32_t id)
+    {
+        if (id / 64 >= words.size())
+            words.resize(id / 64 + 1);
+        words[id / 64] |= 1ull << (id % 64);
+    }
+    bool test(uint32_t id) const { return (id / 64 < words.size()) && ((words[id / 64] >> (id % 64)) & 1); }
+    bool empty() const
+    {
+        return std::ranges::all_of(words, [](uint64_t word) { return word == 0; });
+    }
+
+    bool containsAll(const TagBits& other) const
+    {
+        for (size_t i = 0; i < other.words.size(); ++i)
+            if (other.words[i] & ~(i < words.size() ? words[i] : 0))
+                return false;
+        return true;
+    }
+    bool intersects(const TagBits& other) const
+    {
+        for (size_t i = 0, n = std::min(words.size(), other.words.size()); i < n; ++i)
+            if (words[i] & other.words[i])
+                return true;
+        return false;
+    }
+
+    TagBits& operator|=(const TagBits& other)
+    {
+        if (other.words.size() > words.size())
+            words.resize(other.words.size());
+        for (size_t i = 0; i < other.words.size(); ++i)
+            words[i] |= other.words[i];
+        return *this;
+    }
+    TagBits& operator&=(const TagBits& other)
+    {
+        if (words.size() > other.words.size())
+            words.resize(other.words.size());
+        for (size_t i = 0; i < words.size(); ++i)
+            words[i] &= other.words[i];
+        return *this;
+    }
+
+    template <typename F>
+    void forEach(F&& func) const // set ids, ascending
+    {
+        for (size_t i = 0; i < words.size(); ++i)
+            for (auto word = words[i]; word; word &= word - 1)
+                func(static_cast<uint32_t>(i * 64 + std::countr_zero(word)));
+    }
+
+    std::span<const uint64_t> getWords() const { return words; }
+
+private:
+    std::vector<uint64_t> words = {};
+};
+
+// One row of a TagMatrix.
+class TagRow
+{
+public:
+    explicit TagRow(std::span<const uint64_t> words) :
+        words(words) {}
+
+    bool test(uint32_t id) const { return (id / 64 < words.size()) && ((words[id / 64] >> (id % 64)) & 1); }
+    bool containsAll(const TagBits& mask) const
+    {
+        auto other = mask.getWords();
+        for (size_t i = 0; i < other.size(); ++i)
+            if (other[i] & ~(i < words.size() ? words[i] : 0))
+                return false;
+        return true;
+    }
+    bool intersects(const TagBits& mask) const
+    {
+        auto other = mask.getWords();
+        for (size_t i = 0, n = std::min(words.size(), other.size()); i < n; ++i)
+            if (words[i] & other[i])
+                return true;
+        return false;
+    }
+
+    template <typename F>
+    void forEach(F&& func) const // set ids, ascending
+    {
+        for (size_t i = 0; i < words.size(); ++i)
+            for (auto word = words[i]; word; word &= word - 1)
+                func(static_cast<uint32_t>(i * 64 + std::countr_zero(word)));
+    }
+
+private:
+    std::span<const uint64_t> words;
+};
+
+// Fixed-width tag bits of many anims in one block, row by row.
+class TagMatrix
+{
+public:
+    void assign(size_t rows, size_t bits)
+    {
+        width = (bits + 63) / 64;
+        words.assign(rows * width, 0);
+    }
+    void set(size_t row, uint32_t id) { words[row * width + id / 64] |= 1ull << (id % 64); }
+
+    TagRow operator[](size_t row) const { return TagRow{std::span{words}.subspan(row * width, width)}; }
+    size_t memoryUsage() const { return words.capacity() * sizeof(uint64_t); }
+
+private:
+    size_t                width = 0; // words per row
+    std::vector<uint64_t> words = {};
+};
+
+// Interns tag strings into small dense ids. A copy keeps the ids, so tags can be added to it
+// while the original is still in use.
+class TagTable
+{
+public:
+    TagTable() = default;
+    TagTable(const TagTable& other) :
+        ids(other.ids), names(other.names.size())
+    {
+        for (auto const& [name, id] : ids)
+            names[id] = name;
+    }
+    TagTable(TagTable&&)            = default; // map nodes move along, the views stay valid
+    TagTable& operator=(TagTable&&) = default;
+    TagTable& operator=(const TagTable& other) { return *this = TagTable{other}; }
+
+    uint32_t intern(std::string_view tag)
+    {
+        if (auto it = ids.find(tag); it != ids.end())
+            return it->second;
+        auto [it, _] = ids.emplace(std::string{tag}, static_cast<uint32_t>(names.size()));
+        names.push_back(it->first);
+        return it->second;
+    }
+    std::optional<uint32_t> find(std::string_view tag) const
+    {
+        if (auto it = ids.find(tag); it != ids.end())
+            return it->second;
+        return std::nullopt;
+    }
+    std::string_view getName(uint32_t id) const { return names[id]; }
+    size_t           size() const { return names.size(); }
+    size_t           memoryUsage() const;
+
+private:
+    StrMap<uint32_t>              ids   = {};
+    std::vector<std::string_view> names = {}; // views into the keys of ids
+};
+
+// An anim as its pack defines it, before it is registered.
+struct PackAnim
+{
+    std::string           edid    = {};
+    std::vector<uint32_t> tag_ids = {}; // into the TagTable the pack was read with
+    float                 weight  = 1.f;
+    RE::TESIdleForm*      idle    = nullptr;
+};
+
+// The registry of all anims, sorted by edid, one array per field. pack_bits and pack_weights are
+// what the packs define, tag_bits, exp_bits and weights have the custom overrides and tag expansions
+// on top. Immutable once built, edits build a new one: loading packs rebuilds it, edits to the
+// overrides and expansions copy it and apply them again.
+struct AnimIndex
+{
+    static constexpr uint16_t no_pack = 0xFFFF;
+
+    uint64_t generation      = 0;
+    uint64_t pack_generation = 0; // of the anims and their order, kept by the copies that apply the overrides
+
+    std::string                   edid_pool    = {}; // all edids back to back, sorted, each null terminated for ImGui
+    std::vector<uint32_t>         edid_offsets = {0}; // anim i is [edid_offsets[i], edid_offsets[i + 1] - 1) in the pool
+    TagTable                      tags         = {};
+    TagMatrix                     pack_bits    = {}; // as wide as the table was when the packs were read
+    std::vector<float>            pack_weights = {};
+    TagMatrix                     tag_bits     = {}; // custom tags if set, otherwise the pack's tags
+    TagMatrix                     exp_bits     = {}; // tag_bits plus tag expansions
+    std::vector<float>            weights      = {};
+    bool                          uniform      = true; // all weights are equal, so a plain uniform pick will do
+    std::vector<RE::TESIdleForm*> idles        = {};
+    std::vector<uint16_t>         pack_ids     = {}; // into pack_names, or no_pack
+    std::vector<std::string>      pack_names   = {};
+
+    std::vector<std::pair<RE::FormID, uint32_t>> form_ids = {}; // idle FormID -> anim index, sorted
+
+    // what the overrides were, for the menu
+    std::vector<bool> custom_tags     = {};
+    std::vector<bool> custom_weights  = {};
+    StrMap<StrSet>    tag_expansions  = {};
+    size_t            override_memory = 0; // heap bytes of the override maps, roughly
+
+    // anims each skeleton can play, by skeleton id, see buildCoverage
+    size_t               skeleton_count = 0;
+    std::vector<TagBits> att_coverage   = {};
+    std::vector<TagBits> vic_coverage   = {};
+    std::vector<bool>    covered        = {}; // [att * skeleton_count + vic], any anim for the pair
+
+    uint32_t         size() const { return static_cast<uint32_t>(idles.size()); }
+    std::string_view getEdid(uint32_t anim_idx) const
+    {
+        return std::string_view{edid_pool}.substr(edid_offsets[anim_idx], edid_offsets[anim_idx + 1] - edid_offsets[anim_idx] - 1);
+    }
+    std::string_view getPack(uint32_t anim_idx) const { return (pack_ids[anim_idx] == no_pack) ? std::string_view{} : pack_names[pack_ids[anim_idx]]; }
+    StrSet           getTags(uint32_t anim_idx) const; // of tag_bits
+
+    std::optional<uint32_t> find(std::string_view edid) const
+    {
+        auto anims = std::views::iota(0u, size());
+        if (auto it = std::ranges::lower_bound(anims, edid, {}, [this](uint32_t anim_idx) { return getEdid(anim_idx); });
+            (it != anims.end()) && (getEdid(*it) == edid))
+            return *it;
+        return std::nullopt;
+    }
+
+    std::optional<uint32_t> findForm(RE::FormID form_id) const
+    {
+        auto it = std::ranges::lower_bound(form_ids, form_id, {}, &std::pair<RE::FormID, uint32_t>::first);
+        if ((it != form_ids.end()) && (it->first == form_id))
+            return it->second;
+        return std::nullopt;
+    }
+
+    // unknown tags can't be required by any anim, returns false if there are some
+    bool    makeMask(const StrSet& tag_strs, TagBits& mask) const;
+    TagBits makeMask(const StrSet& tag_strs) const; // unknown tags are ignored
+
+    // skeleton i has the anim tags a_<skeleton_tags[i]> and v_<skeleton_tags[i]>, one more id
+    // stands for all other skeletons. Anims of weight 0 are left out.
+    void                  buildCoverage(std::span<const std::string_view> skeleton_tags);
+    bool                  isCovered(uint8_t att_skel, uint8_t vic_skel) const
+    {
+        size_t cell = att_skel * skeleton_count + vic_skel;
+        return (cell < covered.size()) && covered[cell]; // nothing is covered before the first build
+    }
+    std::vector<uint32_t> getCovered(uint8_t att_skel, uint8_t vic_skel) const; // ascending
+
+    size_t memoryUsage() const; // heap bytes
+};
+} // namespace kaputt
@@ -2,8 +2,9 @@
 
 #include "re.h"
 #include "tasks.h"
-
-#include <effolkronium/random.hpp>
+#include "random.h"
+#include "probability.h"
+#include "failcache.h"
 
 namespace kaputt
 {
@@ -53,8 +54,6 @@ void VanillaTrigger::process()
 
 bool VanillaTrigger::process(RE::Actor* attacker, RE::Actor* victim)
 {
-    auto kap = Kaputt::getSingleton();
-
     // distance fix
     // player check for player to dragon etc.
     // sorry for companions lol
@@ -62,38 +61,16 @@ bool VanillaTrigger::process(RE::Actor* attacker, RE::Actor* victim)
     if (!attacker->IsPlayerRef() && (attacker->GetPosition().GetDistance(victim->GetPosition()) > 192))
         return true;
 
-    // 0-no 1-exec 2-killmove
-    // bleedout check
-    uint8_t do_trigger = enable_bleedout_execution && victim->AsActorState()->IsBleedingOut();
-    // getup check
-    bool getting_up = (victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kGetUp) ||
-        (victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kQueued);
-    if (!do_trigger)
-        do_trigger = enable_getup_execution && getting_up;
-    // should kill cond
-    if (!do_trigger)
-        do_trigger = shouldAttackKill(attacker, victim) * 2;
-
-    if (!do_trigger)
-        return true;
-
-    if (!kap->precondition(attacker, victim))
-        return true;
-
-    if (!lottery(attacker, victim, do_trigger == 1))
-        return true;
-
-    kap->submit(attacker, victim);
+    TriggerPipeline::getSingleton()->run({.trigger                   = TriggerPipeline::Trigger::kVanilla,
+                                          .attacker                  = attacker,
+                                          .victim                    = victim,
+                                          .enable_bleedout_execution = enable_bleedout_execution,
+                                          .enable_getup_execution    = enable_getup_execution,
+                                          .deferred                  = true},
+                                         [&]() { return shouldAttackKill(attacker, victim); });
     return true;
 }
 
-bool VanillaTrigger::lottery(RE::Actor* attacker, RE::Actor* victim, bool is_exec)
-{
-    size_t idx  = -1 + 2 * !attacker->IsPlayerRef() + !victim->IsPlayerRef();
-    float  prob = (is_exec ? prob_exec : prob_km)[idx];
-    return effolkronium::random_static::get(0.f, 100.f) < prob;
-}
-
 bool PostHitTrigger::process(RE::Actor* victim, RE::HitData& hit_data)
 {
     if (!enabled)
@@ -109,44 +86,55 @@ bool PostHitTrigger::process(RE::Actor* victim, RE::HitData& hit_data)
 
     logger::debug("{} hitting {}", attacker->GetName(), victim->GetName());
 
-    // 0-no 1-exec 2-killmove
-    // bleedout check
-    uint8_t do_trigger = enable_bleedout_execution && victim->AsActorState()->IsBleedingOut();
-    // getup check
-    bool getting_up = (victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kGetUp) ||
-        (victim->AsActorState()->GetKnockState() == RE::KNOCK_STATE_ENUM::kQueued);
-    if (!do_trigger)
-        do_trigger = enable_getup_execution && getting_up;
-    // damage check
-    if (!do_trigger)
-    {
-        float dmg_mult = getDamageMult(victim->IsPlayerRef());
-        if (victim->AsActorValueOwner()->GetActorValue(RE::ActorValue::kHealth) <= hit_data.totalDamage * dmg_mult)
-            do_trigger = 2;
-    }
-
-    if (!do_trigger)
-        return false;
+    auto                   pipeline = TriggerPipeline::getSingleton();
+    TriggerPipeline::Event event    = {.trigger                   = TriggerPipeline::Trigger::kPostHit,
+                                       .attacker                  = attacker,
+                                       .victim                    = victim,
+                                       .enable_bleedout_execution = enable_bleedout_execution,
+                                       .enable_getup_execution    = enable_getup_execution,
+                                       .settle_kind               = instakill};
 
-    if (!kap->precondition(attacker, victim))
+    auto kind = pipeline->classify(event, [&]() {
+        float dmg_mult = getDamageMult(victim->IsPlayerRef());
+        return victim->AsActorValueOwner()->GetActorValue(RE::ActorValue::kHealth) <= hit_data.totalDamage * dmg_mult;
+    });
+    if (kind == TriggerPipeline::Kind::kNone)
         return false;
 
-    if (!lottery(attacker, victim, do_trigger == 1))
+    // at most one lottery draw per (victim, attacker, kind) per frame. A later hit with the same attacker and kind
+    // is only evaluated again if it hits harder, the draw was won and nothing got played, and it reuses that draw.
+    auto  frame     = UpdateHook::frame.load(std::memory_order_relaxed);
+    auto& frame_hit = frame_hits.getOrInsert(victim->GetFormID());
+    if (frame_hit.frame != frame)
+        frame_hit = {.frame = frame};
+
+    auto draws = std::span{frame_hit.draws}.first(frame_hit.count);
+    auto it    = std::ranges::find_if(draws, [&](const FrameDraw& draw) { return (draw.attacker == attacker->GetFormID()) && (draw.kind == kind); });
+    bool drawn = (it != draws.end());
+    if (frame_hit.submitted || (drawn ? (!it->won || (hit_data.totalDamage <= it->damage)) : (frame_hit.count == frame_hit.draws.size())))
+    {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
         return false;
+    }
+    if (drawn)
+        it->damage = hit_data.totalDamage;
+    else
+    {
+        auto& draw = frame_hit.draws[frame_hit.count++];
+        draw       = {attacker->GetFormID(), kind, hit_data.totalDamage, pipeline->draw(event, kind)};
+        if (!draw.won)
+            return false;
+    }
+    auto result = pipeline->finish(event, kind);
+    if (auto evaluated = frame_hits.find(victim->GetFormID()); evaluated && (evaluated->frame == frame))
+        evaluated->submitted |= result.submitted;
 
-    if ((do_trigger == 1) && instakill) // instakill operation
+    if ((result.kind == TriggerPipeline::Kind::kExecution) && instakill) // instakill operation
         hit_data.totalDamage = victim->AsActorValueOwner()->GetActorValue(RE::ActorValue::kHealth) / getDamageMult(victim->IsPlayerRef()) + 10;
 
     // auto health = victim->AsActorValueOwner()->GetActorValue(RE::ActorValue::kHealth);
 
-    return kap->submit(attacker, victim);
-}
-
-bool PostHitTrigger::lottery(RE::Actor* attacker, RE::Actor* victim, bool is_exec)
-{
-    size_t idx  = -1 + 2 * !attacker->IsPlayerRef() + !victim->IsPlayerRef();
-    float  prob = (is_exec ? prob_exec : prob_km)[idx];
-    return effolkronium::random_static::get(0.f, 100.f) < prob;
+    return result.submitted;
 }
 
 void SneakTrigger::process(uint32_t scancode)
@@ -179,10 +167,101 @@ void SneakTrigger::process(uint32_t scancode)
     if (need_crouch && !player->IsSneaking())
         return;
 
-    if (!kap->precondition(player, target))
-        return;
-
-    kap->submit(player, target, need_crouch ? SubmitInfoStruct{} : SubmitInfoStruct{.required_tags = {"sneak"}});
+    TriggerPipeline::getSingleton()->run({.trigger     = TriggerPipeline::Trigger::kSneak,
+                                          .attacker    = player,
+                                          .victim      = target,
+                                          .use_lottery = false,
+                                          .deferred    = true,
+                                          .submit_info = need_crouch ? SubmitInfoStruct{} : SubmitInfoStruct{.required_tags = {"sneak"}}},
+                                         []() { return true; });
     return;
 }
+
+TriggerPipeline::Kind TriggerPipeline::classifyState(const Event& event)
+{
+    auto victim_state = event.victim->AsActorState();
+
+    // bleedout check
+    if (event.enable_bleedout_execution && victim_state->IsBleedingOut())
+        return Kind::kExecution;
+    // getup check
+    bool getting_up = (victim_state->GetKnockState() == RE::KNOCK_STATE_ENUM::kGetUp) ||
+        (victim_state->GetKnockState() == RE::KNOCK_STATE_ENUM::kQueued);
+    if (event.enable_getup_execution && getting_up)
+        return Kind::kExecution;
+
+    return Kind::kNone;
+}
+
+bool TriggerPipeline::draw(const Event& event, Kind kind)
+{
+    if (event.use_lottery)
+    {
+        auto  model_trigger = (event.trigger == Trigger::kVanilla) ? ProbabilityModel::Trigger::kVanilla : ProbabilityModel::Trigger::kPostHit;
+        auto& rng           = RandomStreams::getSingleton()->forEvent(RandomStreams::Stream::kLottery);
+        if (!ProbabilityModel::getSingleton()->roll(model_trigger, event.attacker, event.victim, kind == Kind::kExecution, rng))
+            return false;
+    }
+    count(event.trigger, Stage::kLottery);
+    return true;
+}
+
+TriggerPipeline::Result TriggerPipeline::finish(const Event& event, Kind kind)
+{
+    auto kap = Kaputt::getSingleton();
+
+    // nothing will be played, the kind still follows the lottery and the precondition
+    auto unplayed = [&]() {
+        bool passed = event.settle_kind && (kap->checkPrecondition(event.attacker, event.victim) == FailReason::kNone);
+        return Result{.kind = passed ? kind : Kind::kNone};
+    };
+
+    if (!kap->isCovered(event.attacker, event.victim))
+        return unplayed();
+    count(event.trigger, Stage::kCoverage);
+
+    auto fail_cache = FailureCache::getSingleton();
+    auto lookup     = fail_cache->lookup(event.attacker, event.victim);
+    if (lookup == FailureCache::Lookup::kSkip)
+    {
+        if (!event.settle_kind) // unplayed() checks it anyway
+            fail_cache->countSkip();
+        return unplayed();
+    }
+
+    Result result = {};
+    auto   reason = kap->checkPrecondition(event.attacker, event.victim);
+    if (lookup == FailureCache::Lookup::kVerify)
+        fail_cache->countVerify(reason);
+    if (reason == FailReason::kNone)
+    {
+        count(event.trigger, Stage::kPrecondition);
+        result.kind = kind;
+        if (event.deferred)
+        {
+            reason = kap->submitDeferred(
+                event.attacker, event.victim, event.submit_info,
+                [this, trigger = event.trigger, attacker = event.attacker->GetHandle(), victim = event.victim->GetHandle()](FailReason reason) {
+                    if (reason == FailReason::kNone)
+                        count(trigger, Stage::kSubmit);
+                    auto attacker_ptr = attacker.get();
+                    auto victim_ptr   = victim.get();
+                    if (attacker_ptr && victim_ptr)
+                        FailureCache::getSingleton()->record(attacker_ptr.get(), victim_ptr.get(), reason, Kaputt::getSingleton()->getFailCooldown());
+                });
+            result.submitted = (reason == FailReason::kNone);
+            if (result.submitted) // recorded once it's played
+                return result;
+        }
+        else
+        {
+            reason           = kap->trySubmit(event.attacker, event.victim, event.submit_info);
+            result.submitted = (reason == FailReason::kNone);
+            if (result.submitted)
+                count(event.trigger, Stage::kSubmit);
+        }
+    }
+    fail_cache->record(event.attacker, event.victim, reason, kap->getFailCooldown());
+    return result;
+}
 } // namespace kaputt
\ No newline at end of file
@@ -1,10 +1,109 @@
 #pragma once
 
 #include "kaputt.h"
+#include "containers.h"
 
 namespace kaputt
 {
 
+// Stages shared by all triggers: gate (in each trigger) -> classify -> lottery -> coverage -> precondition -> submit.
+// The lottery and coverage go before the precondition since they are far cheaper and usually fail.
+class TriggerPipeline
+{
+public:
+    enum class Trigger : uint32_t
+    {
+        kVanilla,
+        kPostHit,
+        kSneak,
+        kTotal
+    };
+
+    enum class Stage : uint32_t // counters of events that passed each stage
+    {
+        kGate,
+        kClassify,
+        kLottery,
+        kCoverage, // any anim for the skeletons
+        kPrecondition,
+        kSubmit,
+        kTotal
+    };
+
+    enum class Kind : uint8_t
+    {
+        kNone,
+        kExecution,
+        kKillmove
+    };
+
+    struct Event
+    {
+        Trigger          trigger                   = Trigger::kVanilla;
+        RE::Actor*       attacker                  = nullptr;
+        RE::Actor*       victim                    = nullptr;
+        bool             enable_bleedout_execution = false;
+        bool             enable_getup_execution    = false;
+        bool             use_lottery               = true;
+        bool             deferred                  = false; // filter off the game thread and play on the next tick, for triggers that don't use the result
+        bool             settle_kind               = false; // run the precondition even if nothing can be played, for Result::kind
+        SubmitInfoStruct submit_info               = {};
+    };
+
+    struct Result
+    {
+        Kind kind      = Kind::kNone; // set once past the lottery and the precondition
+        bool submitted = false; // or queued, if deferred
+    };
+
+    static TriggerPipeline* getSingleton()
+    {
+        static TriggerPipeline pipeline;
+        return std::addressof(pipeline);
+    }
+
+    // is_lethal is only called when the victim is not up for an execution
+    template <typename LethalCheck>
+    Result run(const Event& event, LethalCheck&& is_lethal)
+    {
+        auto kind = classify(event, std::forward<LethalCheck>(is_lethal));
+        return ((kind == Kind::kNone) || !draw(event, kind)) ? Result{} : finish(event, kind);
+    }
+
+    // the stages of run, for triggers that need to step in between
+    template <typename LethalCheck>
+    Kind classify(const Event& event, LethalCheck&& is_lethal)
+    {
+        count(event.trigger, Stage::kGate);
+
+        auto kind = classifyState(event);
+        if (kind == Kind::kNone && is_lethal())
+            kind = Kind::kKillmove;
+        if (kind != Kind::kNone)
+            count(event.trigger, Stage::kClassify);
+        return kind;
+    }
+    bool   draw(const Event& event, Kind kind);   // the lottery
+    Result finish(const Event& event, Kind kind); // coverage, precondition and submit, for events that won the lottery
+
+    uint64_t getCount(Trigger trigger, Stage stage) const
+    {
+        return counters[static_cast<size_t>(trigger)][static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+    }
+
+private:
+    using Counters = std::array<std::atomic_uint64_t, static_cast<size_t>(Stage::kTotal)>;
+
+    std::array<Counters, static_cast<size_t>(Trigger::kTotal)> counters = {};
+
+    void count(Trigger trigger, Stage stage)
+    {
+        counters[static_cast<size_t>(trigger)][static_cast<size_t>(stage)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static Kind classifyState(const Event& event); // executions
+};
+
 class VanillaTrigger
 {
 public:
@@ -27,7 +126,6 @@ public:
     void process();                               // for player
 private:
     bool process(RE::Actor* attacker, RE::Actor* victim);
-    bool lottery(RE::Actor* attacker, RE::Actor* victim, bool is_exec);
 };
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(VanillaTrigger, enabled, enable_bleedout_execution, enable_getup_execution, prob_km, prob_exec)
 
@@ -52,8 +150,27 @@ public:
 
     bool process(RE::Actor* victim, RE::HitData& hit_data);
 
+    uint64_t getCoalescedCount() const { return coalesced.load(std::memory_order_relaxed); }
+
 private:
-    bool lottery(RE::Actor* attacker, RE::Actor* victim, bool is_exec);
+    // the lottery draws made on a victim this frame, one per attacker and kind
+    struct FrameDraw
+    {
+        RE::FormID            attacker = 0;
+        TriggerPipeline::Kind kind     = TriggerPipeline::Kind::kNone;
+        float                 damage   = 0.f; // strongest hit evaluated on the draw
+        bool                  won      = false;
+    };
+    struct FrameHit
+    {
+        uint64_t                 frame     = static_cast<uint64_t>(-1);
+        std::array<FrameDraw, 4> draws     = {};
+        uint8_t                  count     = 0;
+        bool                     submitted = false; // something was played on the victim
+    };
+
+    FormTable<FrameHit, 64> frame_hits = {};
+    std::atomic_uint64_t    coalesced  = 0; // evaluations skipped
 };
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(PostHitTrigger, enabled, enable_bleedout_execution, enable_getup_execution, instakill, prob_km, prob_exec)
 
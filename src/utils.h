@@ -35,6 +35,31 @@ inline bool isBetweenAngle(float a, float lb, float ub)
     return a <= ub;
 }
 
+// Rough heap bytes of the node based containers, for memory reports. MSVC layout: strings keep
+// 15 chars inline, tree nodes carry 3 pointers and 2 flags ahead of the value.
+constexpr size_t tree_node_overhead = 32;
+
+inline size_t heapSize(const std::string& str) { return (str.size() > 15) ? (str.size() | 15) + 1 : 0; }
+inline size_t heapSize(const StrSet& set)
+{
+    size_t bytes = 0;
+    for (auto const& str : set)
+        bytes += tree_node_overhead + sizeof(std::string) + heapSize(str);
+    return bytes;
+}
+template <typename T>
+size_t heapSize(const StrMap<T>& map)
+{
+    size_t bytes = 0;
+    for (auto const& [key, value] : map)
+    {
+        bytes += tree_node_overhead + sizeof(std::pair<const std::string, T>) + heapSize(key);
+        if constexpr (std::is_same_v<T, StrSet>)
+            bytes += heapSize(value);
+    }
+    return bytes;
+}
+
 enum : uint32_t
 {
     kInvalid        = static_cast<uint32_t>(-1),